@@ -0,0 +1,47 @@
+#include "admission_control.h"
+
+namespace admission {
+
+/* ------------------------ QueueTicket ----------------------------------- */
+
+QueueTicket& QueueTicket::operator=(QueueTicket&& other) noexcept{
+    if(this != &other){
+        if(limiter_){
+            limiter_->Release();
+        }
+        limiter_ = std::exchange(other.limiter_, nullptr);
+    }
+    return *this;
+}
+
+QueueTicket::~QueueTicket(){
+    if(limiter_){
+        limiter_->Release();
+    }
+}
+
+/* ------------------------ QueueLimiter ----------------------------------- */
+
+QueueTicket QueueLimiter::TryAcquire(Priority priority){
+    /* Нулевой предел означает, что очередь не ограничена */
+    if(max_depth_ == 0){
+        depth_.fetch_add(1, std::memory_order_relaxed);
+        return QueueTicket(this);
+    }
+
+    const size_t limit = (priority == Priority::HIGH) ? max_depth_ : low_priority_depth_;
+    size_t depth = depth_.load(std::memory_order_relaxed);
+    do{
+        if(depth >= limit){
+            return QueueTicket();
+        }
+    } while(!depth_.compare_exchange_weak(depth, depth + 1, std::memory_order_relaxed));
+
+    return QueueTicket(this);
+}
+
+void QueueLimiter::Release(){
+    depth_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+} // namespace admission
@@ -0,0 +1,127 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace admission {
+
+/*
+    Приоритет запроса при перегрузке.
+    Запросы с низким приоритетом отбрасываются первыми.
+*/
+enum class Priority{
+    LOW,
+    HIGH
+};
+
+class QueueLimiter;
+
+/* ------------------------ QueueTicket ----------------------------------- */
+
+/*
+    Место в очереди api_strand.
+    Освобождается при разрушении, т.е. когда обработчик запроса выполнен или отброшен.
+*/
+class QueueTicket{
+public:
+    QueueTicket() = default;
+
+    explicit QueueTicket(QueueLimiter* limiter)
+        : limiter_(limiter){}
+
+    QueueTicket(const QueueTicket&) = delete;
+    QueueTicket& operator=(const QueueTicket&) = delete;
+
+    QueueTicket(QueueTicket&& other) noexcept
+        : limiter_(std::exchange(other.limiter_, nullptr)){}
+
+    QueueTicket& operator=(QueueTicket&& other) noexcept;
+
+    ~QueueTicket();
+
+    explicit operator bool() const{
+        return limiter_ != nullptr;
+    }
+private:
+    QueueLimiter* limiter_ = nullptr;
+};
+
+/* ------------------------ QueueLimiter ----------------------------------- */
+
+/*
+    Учитывает количество обработчиков, ожидающих выполнения в api_strand.
+    Запросы с низким приоритетом принимаются, пока очередь не превысит low_priority_depth,
+    запросы с высоким приоритетом - пока очередь не превысит max_depth.
+*/
+class QueueLimiter{
+public:
+    explicit QueueLimiter(size_t max_depth)
+        : max_depth_(max_depth)
+        , low_priority_depth_(max_depth - max_depth / 4){}
+
+    /* Возвращает пустой билет, если очередь переполнена */
+    QueueTicket TryAcquire(Priority priority);
+
+    size_t GetDepth() const{
+        return depth_.load(std::memory_order_relaxed);
+    }
+
+    size_t GetMaxDepth() const{
+        return max_depth_;
+    }
+private:
+    friend QueueTicket;
+
+    void Release();
+
+    std::atomic<size_t> depth_{0};
+    size_t max_depth_;
+    size_t low_priority_depth_;
+};
+
+/* ------------------------ ActionCoalescer ----------------------------------- */
+
+/*
+    Ограничивает число действий одного игрока в очереди api_strand одним.
+    Пока действие игрока ожидает выполнения, новые действия того же игрока
+    не ставятся в очередь, а заменяют ожидающее. Выполняется только последнее,
+    а ответ получают все объединенные запросы.
+*/
+template <typename Key, typename Action, typename Result, typename Hasher = std::hash<Key>>
+class ActionCoalescer{
+public:
+    using Waiter = std::function<void(const Result&)>;
+
+    struct Pending{
+        Action action;
+        std::vector<Waiter> waiters;
+    };
+
+    /*
+        Возвращает true, если для ключа не было ожидающего действия
+        и вызывающий должен поставить обработчик в очередь
+    */
+    bool Submit(const Key& key, Action action, Waiter waiter){
+        std::lock_guard lock{mutex_};
+        auto [it, is_new] = pending_.try_emplace(key);
+        it->second.action = std::move(action);
+        it->second.waiters.push_back(std::move(waiter));
+        return is_new;
+    }
+
+    /* Забирает последнее действие и всех ожидающих ответа */
+    Pending Take(const Key& key){
+        std::lock_guard lock{mutex_};
+        auto node = pending_.extract(key);
+        return std::move(node.mapped());
+    }
+private:
+    std::mutex mutex_;
+    std::unordered_map<Key, Pending, Hasher> pending_;
+};
+
+} // namespace admission
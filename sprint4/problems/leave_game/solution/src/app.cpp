@@ -1,6 +1,11 @@
 #include "app.h"
+#include "logger.h"
+#include <algorithm>
 #include <stdexcept>
+#include <filesystem>
 #include <iostream>
+#include <memory_resource>
+#include <unordered_map>
 
 namespace app{
 
@@ -29,6 +34,9 @@ void Ticker::OnTick(sys::error_code ec) {
 
     if (!ec) {
         auto this_tick = Clock::now();
+        /* Сколько сработавший таймер ждал своей очереди в strand */
+        metrics::GetServerMetrics().GetStrandQueueWait(task_class_).Observe(
+            duration_cast<nanoseconds>(std::max(this_tick - timer_.expiry(), Clock::duration::zero())).count());
         auto delta = duration_cast<milliseconds>(this_tick - last_tick_);
         last_tick_ = this_tick;
         handler_(delta);
@@ -50,6 +58,12 @@ void PlayerTimeClock::IncreaseTime(size_t delta){
     }
 }
 
+void PlayerTimeClock::AddInactivity(Milliseconds time){
+    if(inactivity_start_time_){
+        current_inactivity_time_ = current_inactivity_time_.value_or(inactivity_start_time_.value()) + time;
+    }
+}
+
 std::optional<Milliseconds> PlayerTimeClock::GetInactivityTime() const{
     if(current_inactivity_time_ && inactivity_start_time_){
         return duration_cast<Milliseconds>(current_inactivity_time_.value() - inactivity_start_time_.value());
@@ -83,108 +97,113 @@ Milliseconds PlayerTimeClock::GetPlaytime() const{
 /* ------------------------ GetMapUseCase ----------------------------------- */
 
 std::string GetMapUseCase::MakeMapDescription(const Map* map){
-    json::object map_description;
-
-    map_description["id"] = *(map->GetId());
-    map_description["name"] =  map->GetName();
-    map_description["roads"] = GetRoadsInJSON(map->GetRoads());
-    map_description["buildings"] = GetBuildingsInJSON(map->GetBuildings());
-    map_description["offices"] = GetOfficesInJSON(map->GetOffices());
-    map_description["lootTypes"] = GetLootTypesInJSON(map->GetLootTypes());
+    std::string result;
+    JsonWriter writer(result);
+
+    writer.StartObject();
+    writer.Key("id").String(*(map->GetId()));
+    writer.Key("name").String(map->GetName());
+    writer.Key("roads");
+    WriteRoadsInJSON(writer, map->GetRoads());
+    writer.Key("buildings");
+    WriteBuildingsInJSON(writer, map->GetBuildings());
+    writer.Key("offices");
+    WriteOfficesInJSON(writer, map->GetOffices());
+    writer.Key("lootTypes");
+    WriteLootTypesInJSON(writer, map->GetLootTypes());
     unsigned bag_cap = map->GetBagCapacity();
     if(bag_cap == 3){
-        map_description["bagCapacity"] = map->GetBagCapacity();
+        writer.Key("bagCapacity").Uint(bag_cap);
     }
+    writer.EndObject();
 
-
-    return json::serialize(map_description); 
+    return result; 
 }
 
 
-json::array GetMapUseCase::GetRoadsInJSON(const Map::Roads& roads){
-    json::array result;
+void GetMapUseCase::WriteRoadsInJSON(JsonWriter& writer, const Map::Roads& roads){
+    writer.StartArray();
 
     for(const Road& road : roads){
-        json::object obj;
-        obj["x0"] = road.GetStart().x;
-        obj["y0"] = road.GetStart().y;
-        if(road.IsHorizontal()){
-            obj["x1"] = road.GetEnd().x;
-        } else if(road.IsVertical()){
-            obj["y1"] = road.GetEnd().y;
-        } else {
+        if(!road.IsHorizontal() && !road.IsVertical()){
             break;
         }
 
-        result.push_back(obj); 
+        writer.StartObject();
+        writer.Key("x0").Int(road.GetStart().x);
+        writer.Key("y0").Int(road.GetStart().y);
+        if(road.IsHorizontal()){
+            writer.Key("x1").Int(road.GetEnd().x);
+        } else {
+            writer.Key("y1").Int(road.GetEnd().y);
+        }
+        writer.EndObject();
     }
-    
 
-    return result;
+    writer.EndArray();
 }
 
-json::array GetMapUseCase::GetBuildingsInJSON(const Map::Buildings& buildings){
-    json::array result;
+void GetMapUseCase::WriteBuildingsInJSON(JsonWriter& writer, const Map::Buildings& buildings){
+    writer.StartArray();
 
     for(const Building& building : buildings){
-        json::object obj;
-        obj["x"] = building.GetBounds().position.x;
-        obj["y"] = building.GetBounds().position.y;
-        obj["w"] = building.GetBounds().size.width;
-        obj["h"] = building.GetBounds().size.height;
-        result.push_back(obj);
+        writer.StartObject();
+        writer.Key("x").Int(building.GetBounds().position.x);
+        writer.Key("y").Int(building.GetBounds().position.y);
+        writer.Key("w").Int(building.GetBounds().size.width);
+        writer.Key("h").Int(building.GetBounds().size.height);
+        writer.EndObject();
     }
 
-    return result;
+    writer.EndArray();
 }
 
-json::array GetMapUseCase::GetOfficesInJSON(const Map::Offices& offices){
-    json::array result;
+void GetMapUseCase::WriteOfficesInJSON(JsonWriter& writer, const Map::Offices& offices){
+    writer.StartArray();
 
     for(const Office& office : offices){
-        json::object obj;
-        obj["id"] = *(office.GetId());
-        obj["x"] = office.GetPosition().x;
-        obj["y"] = office.GetPosition().y;
-        obj["offsetX"] = office.GetOffset().dx;
-        obj["offsetY"] = office.GetOffset().dy;
-        result.push_back(obj);
+        writer.StartObject();
+        writer.Key("id").String(*(office.GetId()));
+        writer.Key("x").Int(office.GetPosition().x);
+        writer.Key("y").Int(office.GetPosition().y);
+        writer.Key("offsetX").Int(office.GetOffset().dx);
+        writer.Key("offsetY").Int(office.GetOffset().dy);
+        writer.EndObject();
     }
 
-    return result;
+    writer.EndArray();
 }
 
-json::array GetMapUseCase::GetLootTypesInJSON(const Map::LootTypes& loot_types){
-    json::array result;
+void GetMapUseCase::WriteLootTypesInJSON(JsonWriter& writer, const Map::LootTypes& loot_types){
+    writer.StartArray();
 
     for(const LootType& lt : loot_types){
-        json::object obj;
+        writer.StartObject();
         if(lt.name.has_value()){
-            obj["name"] = *lt.name;
+            writer.Key("name").String(*lt.name);
         }
         if(lt.file.has_value()){
-            obj["file"] = *lt.file;
+            writer.Key("file").String(*lt.file);
         }
         if(lt.type.has_value()){
-            obj["type"] = *lt.type;
+            writer.Key("type").String(*lt.type);
         }
         if(lt.rotation.has_value()){
-            obj["rotation"] = *lt.rotation;
+            writer.Key("rotation").Uint(*lt.rotation);
         }
         if(lt.color.has_value()){
-            obj["color"] = *lt.color;
+            writer.Key("color").String(*lt.color);
         }
         if(lt.scale.has_value()){
-            obj["scale"] = *lt.scale;
+            writer.Key("scale").Double(*lt.scale);
         }
         if(lt.value.has_value()){
-            obj["value"] = *lt.value;
+            writer.Key("value").Uint(*lt.value);
         }
-
-        result.push_back(obj);
+        writer.EndObject();
     }
 
-    return result;
+    writer.EndArray();
 }
 
 /* ------------------------ ListMapsUseCase ----------------------------------- */
@@ -203,33 +222,34 @@ std::string ListMapsUseCase::MakeMapsList(const Game::Maps& maps){
 
 /* ------------------------ GameUseCase ----------------------------------- */
 
-std::string GameUseCase::JoinGame(const std::string& user_name, const std::string& str_map_id, 
+std::string GameUseCase::JoinGame(const std::string& user_name, const Map& map, 
                         Game& game, bool is_random_spawn_enabled){
     using namespace std::literals;
-    Map::Id map_id(str_map_id);
+    InvalidateState();
 
-    GameSession* session = game.SessionIsExists(map_id);
+    GameSession* session = game.SessionIsExists(map);
     if(session == nullptr){
-        session = game.AddSession(map_id);
+        session = game.AddSession(map);
     }
 
     Dog::Name dog_name(user_name);
     Dog::Position dog_pos = (is_random_spawn_enabled) 
-        ? Dog::Position(Map::GetRandomPos(game.FindMap(map_id)->GetRoads())) 
-        : Dog::Position(Map::GetFirstPos(game.FindMap(map_id)->GetRoads()));
+        ? Dog::Position(Map::GetRandomPos(map.GetRoads())) 
+        : Dog::Position(Map::GetFirstPos(map.GetRoads()));
     Dog::Speed dog_speed({0, 0});
     Direction dog_dir = Direction::NORTH;
 
-    Dog* dog = session->AddDog(auto_counter_, dog_name, dog_pos, 
+    /* Id игрока и его собаки не пересекается с id игроков, восстановленных из сохранения */
+    const int id = players_.GetNextId();
+    Dog* dog = session->AddDog(id, dog_name, dog_pos, 
                                         dog_speed, dog_dir);
     /*
         С появлением нового игрока в сессии,
         нужно обновить количество потерянных объектов
     */
     session->UpdateLoot(session->GetDogs().size() - session->GetLootObjects().size());
-    Player& player = players_.Add(auto_counter_, Player::Name(user_name), 
+    Player& player = players_.Add(id, Player::Name(user_name), 
                                         dog, session);
-    ++auto_counter_;
 
     Token token = tokens_.AddPlayer(player);
     /* 
@@ -238,23 +258,81 @@ std::string GameUseCase::JoinGame(const std::string& user_name, const std::strin
     AddPlayerTimeClock(&player);
     
     json::object json_body;
-    json_body["authToken"] = *token;
+    json_body["authToken"] = token.ToString();
     json_body["playerId"] = player.GetId();
 
     return json::serialize(json_body);   
 }
 
-std::string GameUseCase::GetGameState(const Token& token) const{
-    json::object result;
-    const GameSession* session = tokens_.FindPlayerByToken(token)->GetSession();
+compression::EncodedBody GameUseCase::GetGameState(const Token& token, compression::Encoding accepted, 
+                                                   std::optional<double> interest_radius) const{
+    const Player* player = tokens_.FindPlayerByToken(token);
+    const GameSession* session = player->GetSession();
+
+    StateSnapshot& snapshot = state_snapshots_[session];
+    if(auto map_radius = session->GetMap()->GetInterestRadius()){
+        interest_radius = std::min(interest_radius.value_or(*map_radius), *map_radius);
+    }
+    if(interest_radius){
+        return GetNearbyState(*player, snapshot, *interest_radius, accepted);
+    }
 
-    result["players"] = GetPlayers(tokens_.GetPlayersBySession(session));
-    result["lostObjects"] = GetLostObjects(session->GetLootObjects());
+    if(snapshot.version != state_version_){
+        JsonWriter writer(*compression::PrepareCacheString(snapshot.json));
+        writer.StartObject();
+        writer.Key("players");
+        WritePlayers(writer, tokens_.GetPlayersBySession(session));
+        writer.Key("lostObjects");
+        WriteLostObjects(writer, session->GetLootObjects());
+        writer.EndObject();
+
+        snapshot.encoded.Reset();
+        snapshot.version = state_version_;
+    }
 
-    return json::serialize(result);
+    return snapshot.encoded.Get(snapshot.json, accepted);
+}
+
+compression::EncodedBody GameUseCase::GetNearbyState(const Player& player, StateSnapshot& snapshot, 
+                                                     double interest_radius, compression::Encoding accepted) const{
+    const GameSession* session = player.GetSession();
+    if(snapshot.index_version != state_version_){
+        const double cell_size = session->GetMap()->GetInterestRadius().value_or(DEFAULT_INTEREST_CELL_SIZE);
+        snapshot.players.Clear(cell_size);
+        for(const Player* session_player : tokens_.GetPlayersBySession(session)){
+            snapshot.players.Insert(*(session_player->GetDog()->GetPosition()), session_player);
+        }
+        snapshot.loot.Clear(cell_size);
+        for(const Loot& loot : session->GetLootObjects()){
+            snapshot.loot.Insert(loot.pos, &loot);
+        }
+        snapshot.index_version = state_version_;
+    }
+
+    /* Ответ свой у каждого игрока, поэтому не кешируется */
+    const PairDouble& center = *(player.GetDog()->GetPosition());
+    std::string body;
+    JsonWriter writer(body);
+    writer.StartObject();
+    writer.Key("players");
+    writer.StartObject();
+    snapshot.players.ForEachInRadius(center, interest_radius, [&writer](const Player* nearby){
+        WritePlayer(writer, *nearby);
+    });
+    writer.EndObject();
+    writer.Key("lostObjects");
+    writer.StartObject();
+    snapshot.loot.ForEachInRadius(center, interest_radius, [&writer](const Loot* loot){
+        WriteLostObject(writer, *loot);
+    });
+    writer.EndObject();
+    writer.EndObject();
+
+    return compression::Encode(std::move(body), accepted);
 }
 
 std::string GameUseCase::SetAction(const json::object& action, const Token& token){
+    InvalidateState();
     Player* player = tokens_.FindPlayerByToken(token);
     double dog_speed = player->GetSession()->GetMap()->GetDogSpeed();
     Direction new_dir;
@@ -279,26 +357,78 @@ std::string GameUseCase::SetAction(const json::object& action, const Token& toke
 }
 
 std::string GameUseCase::IncreaseTime(unsigned delta, Game& game){
-    std::deque<const Player*> retired_players;
+    InvalidateState();
+    auto& server_metrics = metrics::GetServerMetrics();
+    auto retire_start = metrics::Clock::now();
+
+    retired_players_.clear();
     for(auto& [player, clock] : clocks_){
         clock.IncreaseTime(delta);
-        auto inactivity_time = clock.GetInactivityTime();
-        if(inactivity_time.has_value()){
-            unsigned converted_time_ms = static_cast<double>(inactivity_time->count());
-            if(converted_time_ms >= (game.GetDogRetirementTime() * 1000)){
-                retired_players.push_back(player);
+        if(IsRetired(clock, game)){
+            retired_players_.push_back(player);
+        }
+    }
+    RetirePlayers(retired_players_, game);
+
+    auto simulate_start = metrics::Clock::now();
+    server_metrics.GetTickDuration(metrics::TickPhase::RETIRE).Observe(metrics::ElapsedNs(retire_start, simulate_start));
+
+    game.UpdateGameState(delta);
+
+    /* 
+        Собаки, остановившиеся внутри интервала, простояли его остаток.
+        При больших интервалах этого может хватить для ухода на пенсию.
+        Таблица живет до конца тика, поэтому ее память берется из арены тика
+    */
+    if(const Game::StoppedDogs& stopped_dogs = game.GetStoppedDogs(); !stopped_dogs.empty()){
+        std::pmr::unordered_map<const Dog*, double> idle_times(stopped_dogs.begin(), stopped_dogs.end(), 
+            stopped_dogs.size(), std::hash<const Dog*>{}, std::equal_to<const Dog*>{}, game.GetTickArena().GetResource());
+        retired_players_.clear();
+        for(auto& [player, clock] : clocks_){
+            auto it = idle_times.find(player->GetDog());
+            if(it == idle_times.end()){
+                continue;
+            }
+            clock.AddInactivity(duration_cast<Milliseconds>(std::chrono::duration<double>(it->second)));
+            if(IsRetired(clock, game)){
+                retired_players_.push_back(player);
             }
         }
+        RetirePlayers(retired_players_, game);
+    }
+    /* В установившемся режиме временные данные тика не выделяются в куче */
+    server_metrics.tick_heap_allocations.Add(game.GetTickArena().TakeHeapAllocations());
+    server_metrics.tick_arena_bytes.Set(static_cast<int64_t>(game.GetTickArena().GetCapacity()));
+    RetireSessions(delta, game);
+
+    server_metrics.GetTickDuration(metrics::TickPhase::SIMULATE).Observe(metrics::ElapsedNs(simulate_start));
+
+    return "{}";
+}
+
+bool GameUseCase::IsRetired(const detail::PlayerTimeClock& clock, const Game& game){
+    auto inactivity_time = clock.GetInactivityTime();
+    if(!inactivity_time.has_value()){
+        return false;
     }
+    unsigned converted_time_ms = static_cast<double>(inactivity_time->count());
+    return converted_time_ms >= (game.GetDogRetirementTime() * 1000);
+}
 
-    for(const Player* player : retired_players){
+void GameUseCase::RetirePlayers(const std::vector<Player*>& retired_players, Game& game){
+    for(Player* player : retired_players){
         SaveScore(player, game);
         DisconnectPlayer(player, game);
     }
+}
 
-    game.UpdateGameState(delta);
-
-    return "{}";
+void GameUseCase::RetireSessions(unsigned delta, Game& game){
+    const Game::RetiredSessions& retired_sessions = game.RetireEmptySessions(delta);
+    for(const GameSession* session : retired_sessions){
+        state_snapshots_.erase(session);
+        tokens_.DeleteSession(session);
+    }
+    metrics::GetServerMetrics().retired_game_sessions.Add(retired_sessions.size());
 }
 
 void GameUseCase::GenerateLoot(Milliseconds delta, Game& game){
@@ -320,81 +450,80 @@ std::string GameUseCase::GetRecords(unsigned start, unsigned max_items){
     return json::serialize(records);
 }
 
-json::array GameUseCase::GetBagItems(const Dog::Bag& bag_items){
-    json::array items;
+void GameUseCase::WriteBagItems(JsonWriter& writer, const Dog::Bag& bag_items){
+    writer.StartArray();
     for(const Loot& loot : *bag_items){
-        json::object loot_desc;
-        loot_desc["id"] = loot.id;
-        loot_desc["type"] = loot.type;
-
-        items.push_back(loot_desc);
+        writer.StartObject();
+        writer.Key("id").Uint(loot.id);
+        writer.Key("type").Uint(loot.type);
+        writer.EndObject();
     }   
-
-    return items;
+    writer.EndArray();
 };
 
-json::object GameUseCase::GetPlayers(const PlayerTokens::PlayersInSession& players_in_session) const{
-    json::object players;
+void GameUseCase::WritePlayers(JsonWriter& writer, const PlayerTokens::PlayersInSession& players_in_session) const{
+    writer.StartObject();
 
     for(const Player* player : players_in_session){
-        json::object player_attributes;
-
-        const PairDouble& pos = *(player->GetDog()->GetPosition());
-        player_attributes["pos"] = {pos.x, pos.y};
-        
-        const PairDouble& speed = *(player->GetDog()->GetSpeed());
-        player_attributes["speed"] = {speed.x, speed.y};
+        WritePlayer(writer, *player);
+    }
 
-        Direction dir = player->GetDog()->GetDirection();
-        switch (dir)
-        {
-            case Direction::NORTH:
-                player_attributes["dir"] = "U";
-                break;
-            case Direction::SOUTH:
-                player_attributes["dir"] = "D";
-                break;
-            case Direction::WEST:
-                player_attributes["dir"] = "L";
-                break;
-            case Direction::EAST:
-                player_attributes["dir"] = "R";
-                break;
-            default:
-                player_attributes["dir"] = "Unknown";
-        }
+    writer.EndObject();
+}
 
-        player_attributes["bag"] = GetBagItems(player->GetDog()->GetBag());
-        player_attributes["score"] = player->GetDog()->GetScore();
-        // auto time = clocks_.at(player).GetInactivityTime();
-        // if(time.has_value()){
-        //     player_attributes["retirement_time"] = time->count();
-        // } else {
-        //     json::value empty;
-        //     empty.emplace_null();
-        //     player_attributes["retirement_time"] = empty;
-        // }
+void GameUseCase::WritePlayer(JsonWriter& writer, const Player& player){
+    writer.Key(static_cast<uint64_t>(player.GetId()));
+    writer.StartObject();
 
-        players[std::to_string(player->GetId())] = player_attributes;
+    const PairDouble& pos = *(player.GetDog()->GetPosition());
+    writer.Key("pos").Pair(pos.x, pos.y);
+    
+    const PairDouble& speed = *(player.GetDog()->GetSpeed());
+    writer.Key("speed").Pair(speed.x, speed.y);
+
+    Direction dir = player.GetDog()->GetDirection();
+    writer.Key("dir");
+    switch (dir)
+    {
+        case Direction::NORTH:
+            writer.String("U");
+            break;
+        case Direction::SOUTH:
+            writer.String("D");
+            break;
+        case Direction::WEST:
+            writer.String("L");
+            break;
+        case Direction::EAST:
+            writer.String("R");
+            break;
+        default:
+            writer.String("Unknown");
     }
 
-    return players;
+    writer.Key("bag");
+    WriteBagItems(writer, player.GetDog()->GetBag());
+    writer.Key("score").Uint(player.GetDog()->GetScore());
+
+    writer.EndObject();
 }
 
-json::object GameUseCase::GetLostObjects(const std::list<Loot>& loots){
-    json::object lost_objects;
+void GameUseCase::WriteLostObjects(JsonWriter& writer, const std::list<Loot>& loots){
+    writer.StartObject();
     
     for(const Loot& loot : loots){
-        json::object loot_decs;
-
-        loot_decs["type"] = loot.type;
-        json::array pos = { loot.pos.x, loot.pos.y };
-        loot_decs["pos"] = pos;
-
-        lost_objects[std::to_string(loot.id)] = loot_decs;
+        WriteLostObject(writer, loot);
     }
 
-    return lost_objects;
+    writer.EndObject();
+}
+
+void GameUseCase::WriteLostObject(JsonWriter& writer, const Loot& loot){
+    writer.Key(loot.id);
+    writer.StartObject();
+    writer.Key("type").Uint(loot.type);
+    writer.Key("pos").Pair(loot.pos.x, loot.pos.y);
+    writer.EndObject();
 }
 
 void GameUseCase::AddPlayerTimeClock(Player* player){
@@ -409,7 +538,7 @@ void GameUseCase::AddPlayerTimeClock(Player* player){
     } 
 }
 
-void GameUseCase::SaveScore(const Player* player, Game& game){
+void GameUseCase::SaveScore(Player* player, Game& game){
     std::string name = *(player->GetName());
     unsigned score = player->GetDog()->GetScore();
     double given_time = static_cast<double>(clocks_.at(player).GetPlaytime().count()) / 1000;
@@ -418,8 +547,8 @@ void GameUseCase::SaveScore(const Player* player, Game& game){
     db_manager_->InsertData(name, score, time);
 }
 
-void GameUseCase::DisconnectPlayer(const Player* player, Game& game){
-    const GameSession* player_game_session = player->GetSession();
+void GameUseCase::DisconnectPlayer(Player* player, Game& game){
+    GameSession* player_game_session = player->GetSession();
     const Dog* player_dog =  player->GetDog();
 
     tokens_.DeletePlayer(player);
@@ -427,7 +556,7 @@ void GameUseCase::DisconnectPlayer(const Player* player, Game& game){
     clocks_.erase(it);
     players_.DeletePlayer(player);
 
-    game.DisconnectDogFromSession(player_game_session, player_dog);
+    game.DisconnectDogFromSession(*player_game_session, player_dog);
 }
 
 /* ------------------------ ListPlayersUseCase ----------------------------------- */
@@ -442,6 +571,78 @@ std::string ListPlayersUseCase::GetPlayersInJSON(const PlayerTokens::PlayersInSe
     return json::serialize(player_list);
 }
 
+/* ------------------------ SnapshotWorker ----------------------------------- */
+
+SnapshotWorker::SnapshotWorker(std::string state_file)
+    : state_file_(std::move(state_file))
+    , worker_([this](std::stop_token stop_token){
+        Run(stop_token);
+    }){}
+
+SnapshotWorker::~SnapshotWorker(){
+    Stop();
+}
+
+bool SnapshotWorker::Submit(serialization::GameStateRepr&& state){
+    bool superseded = false;
+    {
+        std::lock_guard lock(mutex_);
+        /* Поток записи остановлен: копия осталась бы в pending_ навсегда */
+        if(stopped_){
+            return false;
+        }
+        superseded = pending_.has_value();
+        pending_ = std::move(state);
+    }
+    wakeup_.notify_one();
+    if(superseded){
+        metrics::GetServerMetrics().snapshots_superseded.Add(1);
+    }
+    return true;
+}
+
+void SnapshotWorker::Stop(){
+    if(!worker_.joinable()){
+        return;
+    }
+    {
+        std::lock_guard lock(mutex_);
+        stopped_ = true;
+    }
+    worker_.request_stop();
+    worker_.join();
+
+    /* Поток завершился, не записав ожидающую копию */
+    if(std::exchange(pending_, std::nullopt)){
+        metrics::GetServerMetrics().snapshots_superseded.Add(1);
+    }
+}
+
+void SnapshotWorker::Run(std::stop_token stop_token){
+    using namespace std::literals;
+    while(true){
+        std::optional<serialization::GameStateRepr> state;
+        {
+            std::unique_lock lock(mutex_);
+            wakeup_.wait(lock, stop_token, [this]{ return pending_.has_value(); });
+            if(stop_token.stop_requested()){
+                return;
+            }
+            state = std::exchange(pending_, std::nullopt);
+        }
+
+        auto write_start = metrics::Clock::now();
+        try{
+            serialization::WriteSnapshot(state_file_, *state);
+        } catch(const std::exception& ex){
+            LOG_ERROR(0, ex.what(), "snapshot"s);
+        }
+        /* Освобождение копии тоже работа фонового потока, поэтому входит в длительность */
+        state.reset();
+        metrics::GetServerMetrics().snapshot_duration.Observe(metrics::ElapsedNs(write_start));
+    }
+}
+
 /* ------------------------ GameStateSaveCase ----------------------------------- */
 
 void GameStateSaveCase::SaveOnTick(bool is_periodic){
@@ -450,34 +651,44 @@ void GameStateSaveCase::SaveOnTick(bool is_periodic){
             Clock::time_point this_tick = Clock::now();
             auto delta = std::chrono::duration_cast<Milliseconds>(this_tick - last_tick_);
             if(delta >= FromInt(save_state_period_.value())){
-                SaveState();
+                SubmitSnapshot();
                 last_tick_ = Clock::now(); 
             }
         } else {
-            SaveState();
+            SubmitSnapshot();
+        }
+    }
+}
+
+void GameStateSaveCase::SubmitSnapshot(){
+    auto copy_start = metrics::Clock::now();
+    serialization::GameStateRepr state(game_, players_);
+    metrics::GetServerMetrics().snapshot_pause.Observe(metrics::ElapsedNs(copy_start));
+    if(!worker_.Submit(std::move(state))){
+        /* Поток записи уже остановлен при завершении: снимок пишется синхронно, чтобы не потерять его */
+        using namespace std::literals;
+        LOG_ERROR(0, "snapshot worker is stopped, writing synchronously"s, "snapshot"s);
+        try{
+            serialization::WriteSnapshot(state_file_, state);
+        } catch(const std::exception& ex){
+            LOG_ERROR(0, ex.what(), "snapshot"s);
         }
     }
 }
 
 void GameStateSaveCase::SaveState(){
-    using namespace std::literals;
-    std::fstream fstrm(state_file_ /*+ "_temp"s*/, std::ios::out);
-    boost::archive::text_oarchive output_archive{fstrm};
-    serialization::GameStateRepr writed_game_state(sessions_, players_);
-    output_archive << writed_game_state;
+    /* Фоновая запись пишет в тот же временный файл, поэтому ее нужно дождаться */
+    worker_.Stop();
+    serialization::GameStateRepr writed_game_state(game_, players_);
+    serialization::WriteSnapshot(state_file_, writed_game_state);
 }
 
 serialization::GameStateRepr GameStateSaveCase::LoadState(){
-    using namespace std::literals;
-    std::fstream fstrm(state_file_, std::ios::in);
-    serialization::GameStateRepr game_state;
-    try{
-        boost::archive::text_iarchive input_archive{fstrm};
-        input_archive >> game_state;
-        return game_state;
-    } catch(...){
-        return game_state;
+    if(!std::filesystem::exists(state_file_)){
+        return {};
     }
+    /* Сохранение прежней версии сервера читается из текстового формата, следующее будет уже бинарным */
+    return serialization::ReadStateFile(state_file_);
 }
 
 }; //namespace app
\ No newline at end of file
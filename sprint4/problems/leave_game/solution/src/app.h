@@ -9,9 +9,17 @@
 #include <optional>
 #include <functional>
 #include <fstream>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
 #include "player.h"
 #include "model_serialization.h"
+#include "state_snapshot.h"
 #include "connection_pool.h"
+#include "json_writer.h"
+#include "metrics.h"
+#include "compression.h"
+#include "spatial_index.h"
 
 namespace app{
 
@@ -23,6 +31,7 @@ using Clock = std::chrono::steady_clock;
 using namespace model::detail;
 using namespace model;
 using DatabaseManagerPtr = std::unique_ptr<db_connection::DatabaseManager>;
+using json_writer::JsonWriter;
 
 namespace detail{
 
@@ -33,9 +42,10 @@ public:
     using Handler = std::function<void(Milliseconds delta)>;
     
     // Функция handler будет вызываться внутри strand с интервалом period
-    Ticker(Strand& strand, Milliseconds period, Handler handler)
+    Ticker(Strand& strand, Milliseconds period, metrics::TaskClass task_class, Handler handler)
         : strand_{strand}
         , period_{period}
+        , task_class_{task_class}
         , handler_{std::move(handler)} {
     }
 
@@ -49,6 +59,7 @@ private:
 
     Strand& strand_;
     Milliseconds period_;
+    metrics::TaskClass task_class_;
     net::steady_timer timer_{strand_};
     Handler handler_;
     Clock::time_point last_tick_;
@@ -63,6 +74,9 @@ public:
 
     void IncreaseTime(size_t delta);
 
+    /* Учитывает бездействие, начавшееся внутри уже учтенного интервала */
+    void AddInactivity(Milliseconds time);
+
     std::optional<Milliseconds> GetInactivityTime() const;
 
     void UpdateActivity(Dog::Speed new_speed);
@@ -86,10 +100,10 @@ class GetMapUseCase{
 public:
     static std::string MakeMapDescription(const Map* map);
 private:
-    static json::array GetRoadsInJSON(const Map::Roads& roads);
-    static json::array GetBuildingsInJSON(const Map::Buildings& buildings);
-    static json::array GetOfficesInJSON(const Map::Offices& offices);
-    static json::array GetLootTypesInJSON(const Map::LootTypes& loot_types);
+    static void WriteRoadsInJSON(JsonWriter& writer, const Map::Roads& roads);
+    static void WriteBuildingsInJSON(JsonWriter& writer, const Map::Buildings& buildings);
+    static void WriteOfficesInJSON(JsonWriter& writer, const Map::Offices& offices);
+    static void WriteLootTypesInJSON(JsonWriter& writer, const Map::LootTypes& loot_types);
 };
 
 /* ------------------------ ListMapsUseCase ----------------------------------- */
@@ -103,15 +117,29 @@ public:
 
 class GameUseCase{
 public:
-    using PlayerTimeClocks = std::unordered_map<const Player*, detail::PlayerTimeClock>;
+    using PlayerTimeClocks = std::unordered_map<Player*, detail::PlayerTimeClock>;
     
     GameUseCase(Players& players, PlayerTokens& tokens, DatabaseManagerPtr&& db_manager)
         : players_(players), tokens_(tokens), db_manager_(std::move(db_manager)){}
 
-    std::string JoinGame(const std::string& user_name, const std::string& str_map_id, 
+    /* Карта уже найдена по строковому id на границе с JSON */
+    std::string JoinGame(const std::string& user_name, const Map& map, 
                             Game& game, bool is_random_spawn_enabled);
 
-    std::string GetGameState(const Token& token) const;
+    /* 
+        Состояние сессии игрока в кодировании, которое принимает клиент.
+        Возвращаемое представление указывает на снимок состояния сессии
+        и действительно до следующего изменения игрового состояния.
+        Если задан радиус видимости (клиентом или картой, действует меньший),
+        ответ содержит только собак и предметы в этом радиусе от собаки игрока
+    */
+    compression::EncodedBody GetGameState(const Token& token, compression::Encoding accepted, 
+                                          std::optional<double> interest_radius = std::nullopt) const;
+
+    /* Сбрасывает снимки состояния сессий. Вызывается при любом изменении игры */
+    void InvalidateState(){
+        ++state_version_;
+    }
 
     std::string SetAction(const json::object& action, const Token& token);
 
@@ -121,18 +149,50 @@ public:
 
     std::string GetRecords(unsigned start, unsigned max_items);
 private:
-    static json::array GetBagItems(const Dog::Bag& bag_items);
-    json::object GetPlayers(const PlayerTokens::PlayersInSession& players_in_session) const;
-    static json::object GetLostObjects(const std::list<Loot>& loots);
+    static void WriteBagItems(JsonWriter& writer, const Dog::Bag& bag_items);
+    void WritePlayers(JsonWriter& writer, const PlayerTokens::PlayersInSession& players_in_session) const;
+    static void WritePlayer(JsonWriter& writer, const Player& player);
+    static void WriteLostObjects(JsonWriter& writer, const std::list<Loot>& loots);
+    static void WriteLostObject(JsonWriter& writer, const Loot& loot);
     void AddPlayerTimeClock(Player* player);
-    void SaveScore(const Player* player, Game& game);
-    void DisconnectPlayer(const Player* player, Game& game);
+    void SaveScore(Player* player, Game& game);
+    void DisconnectPlayer(Player* player, Game& game);
+    static bool IsRetired(const detail::PlayerTimeClock& clock, const Game& game);
+    void RetirePlayers(const std::vector<Player*>& retired_players, Game& game);
+    /* Закрывает сессии, которые пустуют дольше допустимого, и забывает их снимки состояния */
+    void RetireSessions(unsigned delta, Game& game);
 
-    int auto_counter_ = 0;
     Players& players_;
     PlayerTokens& tokens_;
     PlayerTimeClocks clocks_;
     DatabaseManagerPtr db_manager_;
+    /* Игроки, уходящие на пенсию в текущем тике. Память переиспользуется между тиками */
+    std::vector<Player*> retired_players_;
+
+    /*
+        Снимок состояния сессии одинаков для всех ее игроков,
+        поэтому JSON и его сжатые представления строятся один раз на версию состояния
+        и разделяются ответами без копирования.
+        Память буферов переиспользуется между версиями, если их уже не удерживают ответы
+    */
+    struct StateSnapshot{
+        uint64_t version = 0;
+        std::shared_ptr<std::string> json;
+        compression::EncodedCache encoded;
+        /* Индекс объектов сессии для ответов с радиусом видимости, строится по первому такому запросу */
+        uint64_t index_version = 0;
+        GridIndex<const Player*> players;
+        GridIndex<const Loot*> loot;
+    };
+
+    /* Размер ячейки индекса, если радиус видимости не задан картой */
+    static constexpr double DEFAULT_INTEREST_CELL_SIZE = 16.;
+
+    compression::EncodedBody GetNearbyState(const Player& player, StateSnapshot& snapshot, 
+                                            double interest_radius, compression::Encoding accepted) const;
+
+    uint64_t state_version_ = 1;
+    mutable std::unordered_map<const GameSession*, StateSnapshot> state_snapshots_;
 };
 
 /* ------------------------ ListPlayersUseCase ----------------------------------- */
@@ -142,32 +202,74 @@ public:
     static std::string GetPlayersInJSON(const PlayerTokens::PlayersInSession& players);
 };
 
+/* ------------------------ SnapshotWorker ----------------------------------- */
+
+/*
+    Фоновый поток записи снимков состояния.
+    Поток игры передает готовую копию состояния и не ждет записи.
+    Одновременно пишется один снимок. Пока он пишется, ожидает записи только
+    самая свежая копия, более старые отбрасываются
+*/
+class SnapshotWorker{
+public:
+    explicit SnapshotWorker(std::string state_file);
+
+    SnapshotWorker(const SnapshotWorker&) = delete;
+    SnapshotWorker& operator=(const SnapshotWorker&) = delete;
+
+    ~SnapshotWorker();
+
+    /* После Stop копия не принимается и остается у вызывающего: возвращает false */
+    [[nodiscard]] bool Submit(serialization::GameStateRepr&& state);
+
+    /*
+        Дожидается записываемого снимка и останавливает поток.
+        Ожидающая копия отбрасывается и учитывается в snapshots_superseded
+    */
+    void Stop();
+private:
+    void Run(std::stop_token stop_token);
+
+    std::string state_file_;
+    std::mutex mutex_;
+    std::condition_variable_any wakeup_;
+    std::optional<serialization::GameStateRepr> pending_;
+    bool stopped_ = false;
+    std::jthread worker_;
+};
+
 /* ------------------------ GameStateSaveCase ----------------------------------- */
 
 class GameStateSaveCase{
 public:
     GameStateSaveCase(std::string state_file, 
                         std::optional<unsigned> period, 
-                        const Game::SessionsByMapId& sessions, 
+                        const Game& game, 
                         const Players& players)
     : state_file_(state_file), 
     save_state_period_(period),
-    sessions_(sessions),
+    game_(game),
     players_(players),
-    last_tick_(Clock::now()){}
+    last_tick_(Clock::now()),
+    worker_(state_file_){}
 
+    /* Снимает копию состояния на потоке игры, записывает ее фоновый поток */
     void SaveOnTick(bool is_periodic);
 
+    /* Записывает состояние синхронно, например при завершении сервера */
     void SaveState();
 
     serialization::GameStateRepr LoadState();
 
 private:
+    void SubmitSnapshot();
+
     Clock::time_point last_tick_;
     std::string state_file_;
     std::optional<unsigned> save_state_period_; 
-    const Game::SessionsByMapId& sessions_;
+    const Game& game_;
     const Players& players_;
+    SnapshotWorker worker_;
 };
 
 /* --------------------------- Application -------------------------------- */
@@ -198,13 +300,13 @@ public:
                 и таймер на обновления лута
             */
             if(tick_period_.has_value()){
-                time_ticker_ = std::make_shared<detail::Ticker>(api_strand_, FromInt(*tick_period_), [this](Milliseconds delta){
+                time_ticker_ = std::make_shared<detail::Ticker>(api_strand_, FromInt(*tick_period_), metrics::TaskClass::TICK, [this](Milliseconds delta){
                     this->IncreaseTime(delta.count() / 1000);
                 });
 
                 time_ticker_->Start();
 
-                loot_ticker_ = std::make_shared<detail::Ticker>(api_strand_, game_.GetLootGeneratePeriod(), [this](Milliseconds delta){
+                loot_ticker_ = std::make_shared<detail::Ticker>(api_strand_, game_.GetLootGeneratePeriod(), metrics::TaskClass::LOOT, [this](Milliseconds delta){
                     this->GenerateLoot(delta);
                 });
 
@@ -212,15 +314,18 @@ public:
             }
 
             if(state_file.has_value()){
-                state_save_.emplace(state_file.value(), save_state_period, game_.GetAllSessions(), players_);
+                state_save_.emplace(state_file.value(), save_state_period, game_, players_);
             }
         }
     Strand& GetStrand(){
         return api_strand_;
     }
 
-    std::string GetMapsList() const{
-        return ListMapsUseCase::MakeMapsList(game_.GetMaps());
+    compression::EncodedBody GetMapsList(compression::Encoding accepted){
+        if(!maps_list_.json){
+            maps_list_.json = std::make_shared<const std::string>(ListMapsUseCase::MakeMapsList(game_.GetMaps()));
+        }
+        return maps_list_.encoded.Get(maps_list_.json, accepted);
     }
 
     const Map* FindMap(const Map::Id& map_id) const{
@@ -235,22 +340,26 @@ public:
         return tick_period_.has_value();
     }
 
-    std::string GetMapDescription(const Map* map) const{
-        return GetMapUseCase::MakeMapDescription(map);
+    compression::EncodedBody GetMapDescription(const Map* map, compression::Encoding accepted){
+        StaticBody& description = map_descriptions_[map];
+        if(!description.json){
+            description.json = std::make_shared<const std::string>(GetMapUseCase::MakeMapDescription(map));
+        }
+        return description.encoded.Get(description.json, accepted);
     }
 
-    std::string GetJoinGameResult(const std::string& user_name, const std::string& map_id){
-        return game_handler_.JoinGame(user_name, map_id, game_, rand_spawn_);
+    std::string GetJoinGameResult(const std::string& user_name, const Map& map){
+        return game_handler_.JoinGame(user_name, map, game_, rand_spawn_);
     }
 
     std::string GetPlayerList(const Token& token) const{
         const GameSession* session = tokens_.FindPlayerByToken(token)->GetSession();
-        PlayerTokens::PlayersInSession players = tokens_.GetPlayersBySession(session);
-        return ListPlayersUseCase::GetPlayersInJSON(players);
+        return ListPlayersUseCase::GetPlayersInJSON(tokens_.GetPlayersBySession(session));
     }
 
-    std::string GetGameState(const Token& token) const{
-        return game_handler_.GetGameState(token);
+    compression::EncodedBody GetGameState(const Token& token, compression::Encoding accepted, 
+                                          std::optional<double> interest_radius = std::nullopt) const{
+        return game_handler_.GetGameState(token, accepted, interest_radius);
     }
 
     void SaveState(){
@@ -261,12 +370,17 @@ public:
 
     void LoadState(){
         if(state_save_.has_value()){
+            game_handler_.InvalidateState();
             auto game_state = state_save_.value().LoadState();
             for(const auto& [map_id, sessions] : game_state.GetAllSessions()){
+                const Map* map = game_.FindMap(Map::Id(map_id));
+                if(map == nullptr){
+                    throw std::runtime_error("Unknown map in saved state");
+                }
                 for(const auto& session_repr : sessions){
-                    GameSession* session =  game_.AddSession(Map::Id(map_id));
+                    GameSession* session =  game_.AddSession(*map);
                     /* Заполнение потерянных объектов */
-                    session->SetLootObjects(session_repr.GetLoot());
+                    session->SetLootObjects({session_repr.GetLoot().begin(), session_repr.GetLoot().end()});
                     for(const auto& dog_repr : session_repr.GetDogsRepr()){
                         /* Добавление собаки */
                         Dog* created_dog = session->AddCreatedDog(dog_repr.Restore());
@@ -276,7 +390,11 @@ public:
                                     Player::Name(player_repr.GetName()),
                                     created_dog,
                                     session);
-                        tokens_.AddPlayerWithToken(added_player, Token(player_repr.GetToken()));
+                        auto token = Token::Parse(player_repr.GetToken());
+                        if(!token){
+                            throw std::runtime_error("Invalid player token in saved state");
+                        }
+                        tokens_.AddPlayerWithToken(added_player, *token);
                         tokens_.AddPlayerInSession(added_player, session);
                     }
                 }
@@ -289,16 +407,24 @@ public:
         /* 
             Сохраняем игровое состояние 
             синхроннно с ходом игровых часов только в том случае, 
-            когда указан файл сохранения и период
+            когда указан файл сохранения и период.
+            На тике снимается только копия состояния, в файл ее пишет фоновый поток
         */
         if(state_save_.has_value()){
+            auto save_start = metrics::Clock::now();
             state_save_.value().SaveOnTick(tick_period_.has_value());
+            metrics::GetServerMetrics().GetTickDuration(metrics::TickPhase::SAVE).Observe(metrics::ElapsedNs(save_start));
         }
+        UpdateGameMetrics();
         return res;
     }
 
     void GenerateLoot(Milliseconds delta){
-        return game_handler_.GenerateLoot(delta, game_);
+        auto loot_start = metrics::Clock::now();
+        game_handler_.InvalidateState();
+        game_handler_.GenerateLoot(delta, game_);
+        metrics::GetServerMetrics().GetTickDuration(metrics::TickPhase::LOOT).Observe(metrics::ElapsedNs(loot_start));
+        UpdateGameMetrics();
     }
 
     std::string ApplyPlayerAction(const json::object& action, const Token& token){
@@ -309,6 +435,27 @@ public:
         return game_handler_.GetRecords(start, max_items);
     }
 private:
+    /* Обновляет показатели численности сессий, игроков, собак и потерянных объектов */
+    void UpdateGameMetrics() const{
+        int64_t sessions_count = 0;
+        int64_t active_sessions_count = 0;
+        int64_t dogs_count = 0;
+        int64_t loot_count = 0;
+        game_.ForEachSession([&](const GameSession& session){
+            ++sessions_count;
+            active_sessions_count += session.HasMovingDogs() ? 1 : 0;
+            dogs_count += session.GetDogs().size();
+            loot_count += session.GetLootObjects().size();
+        });
+
+        auto& server_metrics = metrics::GetServerMetrics();
+        server_metrics.game_sessions.Set(sessions_count);
+        server_metrics.active_game_sessions.Set(active_sessions_count);
+        server_metrics.players.Set(players_.GetPlayers().size());
+        server_metrics.dogs.Set(dogs_count);
+        server_metrics.loot.Set(loot_count);
+    }
+
     Game& game_;
     Strand api_strand_;
     std::optional<unsigned> tick_period_;
@@ -319,6 +466,18 @@ private:
     GameUseCase game_handler_;
     std::shared_ptr<detail::Ticker> time_ticker_;
     std::shared_ptr<detail::Ticker> loot_ticker_;
+
+    /* 
+        Карты не меняются после загрузки: JSON строится при первом запросе
+        и отдается всем клиентам без копирования 
+    */
+    struct StaticBody{
+        std::shared_ptr<const std::string> json;
+        compression::EncodedCache encoded;
+    };
+
+    StaticBody maps_list_;
+    std::unordered_map<const Map*, StaticBody> map_descriptions_;
 };
 
 } // namespace app
\ No newline at end of file
@@ -0,0 +1,172 @@
+#include "async_logger.h"
+#include "json_writer.h"
+
+#include <boost/date_time/c_local_time_adjustor.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+using namespace std::literals;
+
+namespace logger{
+
+namespace {
+
+/* Период, с которым фоновый поток забирает записи из буферов */
+constexpr auto FLUSH_PERIOD = 5ms;
+
+std::string_view GetRecordMessage(AsyncRecord::Kind kind){
+    switch(kind){
+        case AsyncRecord::Kind::REQUEST_RECEIVED:
+            return "request received"sv;
+        case AsyncRecord::Kind::RESPONSE_SENT:
+            return "response sent"sv;
+    }
+    return {};
+}
+
+/* Локальное время в формате to_iso_extended_string, как у атрибута TimeStamp Boost.Log */
+std::string FormatTimestamp(std::chrono::system_clock::time_point timestamp){
+    namespace pt = boost::posix_time;
+    using local_adjustor = boost::date_time::c_local_adjustor<pt::ptime>;
+
+    const auto since_epoch = std::chrono::duration_cast<std::chrono::microseconds>(timestamp.time_since_epoch());
+    const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(since_epoch);
+    const pt::ptime utc = pt::from_time_t(static_cast<std::time_t>(seconds.count()))
+                        + pt::microseconds((since_epoch - seconds).count());
+    return pt::to_iso_extended_string(local_adjustor::utc_to_local(utc));
+}
+
+} // namespace
+
+/* ------------------------ RecordRing ----------------------------------- */
+
+bool RecordRing::TryPush(const AsyncRecord& record){
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if(head - tail_.load(std::memory_order_acquire) >= CAPACITY){
+        return false;
+    }
+    records_[head % CAPACITY] = record;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+/* ------------------------ AsyncLogger ----------------------------------- */
+
+AsyncLogger& AsyncLogger::Instance(){
+    static AsyncLogger instance;
+    return instance;
+}
+
+AsyncLogger::~AsyncLogger(){
+    Stop();
+}
+
+void AsyncLogger::Start(){
+    if(worker_.joinable()){
+        return;
+    }
+    worker_ = std::jthread([this](std::stop_token stop_token){
+        Run(stop_token);
+    });
+}
+
+void AsyncLogger::Stop(){
+    if(!worker_.joinable()){
+        return;
+    }
+    worker_.request_stop();
+    worker_.join();
+}
+
+void AsyncLogger::Push(const AsyncRecord& record){
+    if(!GetThreadRing().TryPush(record)){
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+bool AsyncLogger::SampleRequest(){
+    const unsigned rate = sample_rate_.load(std::memory_order_relaxed);
+    if(rate == 1){
+        return true;
+    }
+    /* Счетчик свой у каждого потока, чтобы не делить кэш-линию между потоками */
+    thread_local unsigned counter = 0;
+    return counter++ % rate == 0;
+}
+
+RecordRing& AsyncLogger::GetThreadRing(){
+    thread_local std::shared_ptr<RecordRing> ring;
+    if(!ring){
+        ring = std::make_shared<RecordRing>();
+        std::lock_guard lock{rings_mutex_};
+        rings_.push_back(ring);
+    }
+    return *ring;
+}
+
+void AsyncLogger::Run(std::stop_token stop_token){
+    std::string batch;
+    while(!stop_token.stop_requested()){
+        Flush(batch);
+        std::unique_lock lock{flush_mutex_};
+        wakeup_.wait_for(lock, stop_token, FLUSH_PERIOD, []{ return false; });
+    }
+    /* Дописываем то, что успели накопить потоки до остановки */
+    Flush(batch);
+}
+
+size_t AsyncLogger::Flush(std::string& batch){
+    std::vector<std::shared_ptr<RecordRing>> rings;
+    {
+        std::lock_guard lock{rings_mutex_};
+        rings = rings_;
+    }
+
+    batch.clear();
+    size_t count = 0;
+    for(const auto& ring : rings){
+        count += ring->Drain([&batch](const AsyncRecord& record){
+            FormatRecord(record, batch);
+        });
+    }
+    if(count != 0){
+        WriteBatch(batch);
+    }
+    return count;
+}
+
+void FormatRecord(const AsyncRecord& record, std::string& out){
+    if(!out.empty()){
+        out.push_back('\n');
+    }
+
+    json_writer::JsonWriter writer(out);
+    writer.StartObject();
+    writer.Key("timestamp"sv);
+    writer.String(FormatTimestamp(record.timestamp));
+    writer.Key("data"sv);
+    writer.StartObject();
+    writer.Key("ip"sv);
+    writer.String(record.ip.View());
+    switch(record.kind){
+        case AsyncRecord::Kind::REQUEST_RECEIVED:
+            writer.Key("URL"sv);
+            writer.String(record.url.View());
+            writer.Key("method"sv);
+            writer.String(record.method.View());
+            break;
+        case AsyncRecord::Kind::RESPONSE_SENT:
+            writer.Key("response_time"sv);
+            writer.Uint(record.response_time);
+            writer.Key("code"sv);
+            writer.Int(record.code);
+            writer.Key("content_type"sv);
+            writer.String(record.content_type.View());
+            break;
+    }
+    writer.EndObject();
+    writer.Key("message"sv);
+    writer.String(GetRecordMessage(record.kind));
+    writer.EndObject();
+}
+
+} // namespace logger
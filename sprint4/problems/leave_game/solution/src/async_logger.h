@@ -0,0 +1,145 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace logger{
+
+/* Строка фиксированной емкости: копируется без выделения памяти, длинные строки обрезаются */
+template <size_t Capacity>
+class FixedString{
+public:
+    void Assign(std::string_view str){
+        size_ = std::min(str.size(), Capacity);
+        std::memcpy(data_.data(), str.data(), size_);
+    }
+
+    std::string_view View() const{
+        return {data_.data(), size_};
+    }
+private:
+    size_t size_ = 0;
+    std::array<char, Capacity> data_;
+};
+
+/* Двоичная запись журнала о запросе или ответе, формируемая на потоке ввода-вывода */
+struct AsyncRecord{
+    enum class Kind{
+        REQUEST_RECEIVED,
+        RESPONSE_SENT
+    };
+
+    Kind kind;
+    std::chrono::system_clock::time_point timestamp;
+    FixedString<46> ip;
+    FixedString<256> url;
+    FixedString<16> method;
+    FixedString<64> content_type;
+    size_t response_time = 0;
+    int code = 0;
+};
+
+/* ------------------------ RecordRing ----------------------------------- */
+
+/*
+    Кольцевой буфер записей одного потока-производителя.
+    Один производитель и один потребитель (фоновый поток), без блокировок.
+    При переполнении запись отбрасывается, чтобы не задерживать поток ввода-вывода.
+*/
+class RecordRing{
+public:
+    static constexpr size_t CAPACITY = 1024;
+
+    bool TryPush(const AsyncRecord& record);
+
+    /* Извлекает все накопленные записи и передает их в fn */
+    template <typename Fn>
+    size_t Drain(Fn&& fn){
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        const size_t head = head_.load(std::memory_order_acquire);
+        const size_t count = head - tail;
+        for(; tail != head; ++tail){
+            fn(records_[tail % CAPACITY]);
+        }
+        tail_.store(tail, std::memory_order_release);
+        return count;
+    }
+private:
+    std::array<AsyncRecord, CAPACITY> records_;
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::atomic<size_t> tail_{0};
+};
+
+/* ------------------------ AsyncLogger ----------------------------------- */
+
+/*
+    Асинхронный журнал запросов и ответов.
+    Потоки ввода-вывода только копируют двоичную запись в свой кольцевой буфер,
+    а фоновый поток форматирует записи в JSON и пишет их пачками.
+*/
+class AsyncLogger{
+public:
+    static AsyncLogger& Instance();
+
+    AsyncLogger(const AsyncLogger&) = delete;
+    AsyncLogger& operator=(const AsyncLogger&) = delete;
+
+    ~AsyncLogger();
+
+    /* Запускает фоновый поток, передающий пачки записей в Boost.Log */
+    void Start();
+
+    /* Записывает все накопленное и останавливает фоновый поток */
+    void Stop();
+
+    void Push(const AsyncRecord& record);
+
+    /* В журнал попадает каждый rate-й запрос вместе с ответом на него */
+    void SetSampleRate(unsigned rate){
+        sample_rate_.store(std::max(1u, rate), std::memory_order_relaxed);
+    }
+
+    /* Решение о записи принимается один раз на запрос: и для запроса, и для ответа */
+    bool SampleRequest();
+
+    uint64_t GetDroppedCount() const{
+        return dropped_.load(std::memory_order_relaxed);
+    }
+private:
+    AsyncLogger() = default;
+
+    RecordRing& GetThreadRing();
+
+    void Run(std::stop_token stop_token);
+
+    /* Собирает записи из всех буферов в одну пачку и пишет ее. Возвращает число записей */
+    size_t Flush(std::string& batch);
+
+    std::mutex rings_mutex_;
+    std::vector<std::shared_ptr<RecordRing>> rings_;
+
+    std::mutex flush_mutex_;
+    std::condition_variable_any wakeup_;
+    std::jthread worker_;
+
+    std::atomic<unsigned> sample_rate_{1};
+    std::atomic<uint64_t> dropped_{0};
+};
+
+/* Дописывает в out строку в том же виде, в каком JSONFormatter форматирует записи Boost.Log */
+void FormatRecord(const AsyncRecord& record, std::string& out);
+
+/* Передает в Boost.Log пачку готовых строк журнала */
+void WriteBatch(const std::string& batch);
+
+} // namespace logger
@@ -12,6 +12,7 @@ namespace cmd_parser{
     unsigned tick_period;
     std::string state_file;
     unsigned save_state_period;
+    unsigned short metrics_port;
 ;
     desc.add_options()
         ("help,h", "produce help message")
@@ -20,7 +21,20 @@ namespace cmd_parser{
         ("www-root,w", po::value(&args.www_root)->value_name("dir"s), "set static files root")
         ("randomize-spawn-points", "spawn dogs at random positions ")
         ("state-file", po::value(&state_file)->value_name("state-file"s), "set file path, which saves a game state in procces, and restore it at startup")
-        ("save-state-period", po::value(&save_state_period)->value_name("milliseconds"s), "set period for automatic saving of game state.");
+        ("save-state-period", po::value(&save_state_period)->value_name("milliseconds"s), "set period for automatic saving of game state.")
+        ("max-queued-requests", po::value(&args.max_queued_requests)->value_name("count"s), "set limit of API requests waiting for execution, 0 - unlimited (default 1024)")
+        ("request-slice-budget", po::value(&args.request_slice_budget)->value_name("microseconds"s), "run queued API requests for at most this long before letting game ticks in (default 2000)")
+        ("metrics-port", po::value(&metrics_port)->value_name("port"s), "serve Prometheus metrics at /metrics on this admin port")
+        ("log-sample-rate", po::value(&args.log_sample_rate)->value_name("N"s), "log every N-th request and its response (default 1 - log all)")
+        ("slow-request-threshold", po::value(&args.slow_request_threshold)->value_name("milliseconds"s), "keep stage timings of requests slower than threshold, served at /debug/slow-requests on metrics port (default 0 - disabled)")
+        ("io-shards", po::value(&args.io_shards)->value_name("count"s), "accept and serve connections on N single-threaded io_contexts pinned to cores with SO_REUSEPORT acceptors (default 0 - one shared io_context)")
+        ("coroutine-sessions", "serve each connection with a single coroutine instead of completion handler chain")
+        ("idle-timeout", po::value(&args.idle_timeout)->value_name("seconds"s), "close keep-alive connections idle or sending a request longer than this (default 30)")
+        ("release-idle-buffers", "free read buffers of keep-alive connections between requests")
+        ("max-connections", po::value(&args.max_connections)->value_name("count"s), "close new connections above this number of open ones, 0 - unlimited (default 0)")
+        ("compression", "compress API responses with gzip or deflate when the client accepts it")
+        ("compression-level", po::value(&args.compression_level)->value_name("1-9"s), "set zlib compression level (default 6)")
+        ("compression-min-size", po::value(&args.compression_min_size)->value_name("bytes"s), "do not compress responses smaller than this (default 1024)");
         
     // variables_map хранит значения опций после разбора
     po::variables_map vm;
@@ -45,6 +59,10 @@ namespace cmd_parser{
         args.save_state_period = save_state_period;
     }
 
+    if (vm.contains("metrics-port"s)) {
+        args.metrics_port = metrics_port;
+    }
+
     if (!vm.contains("config-file"s)) {
         throw std::runtime_error("Config file path is not specified : Usage game_server -c <file> --w <dir>"s);
     }
@@ -57,6 +75,26 @@ namespace cmd_parser{
         args.randomize_spawn_points = true;
     }
 
+    if (vm.contains("compression"s)) {
+        args.compression = true;
+    }
+
+    if (vm.contains("coroutine-sessions"s)) {
+        args.coroutine_sessions = true;
+    }
+
+    if (vm.contains("release-idle-buffers"s)) {
+        args.release_idle_buffers = true;
+    }
+
+    if (args.idle_timeout == 0) {
+        throw std::runtime_error("Idle timeout must be positive"s);
+    }
+
+    if (args.compression_level < 1 || args.compression_level > 9) {
+        throw std::runtime_error("Compression level must be in range 1-9"s);
+    }
+
     // С опциями программы всё в порядке, возвращаем структуру args
     return args;
 }
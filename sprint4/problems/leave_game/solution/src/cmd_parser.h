@@ -14,6 +14,19 @@ struct Args {
     bool randomize_spawn_points = false;
     std::optional<std::string> state_file;
     std::optional<unsigned> save_state_period;
+    unsigned max_queued_requests = 1024;
+    unsigned request_slice_budget = 2000;
+    std::optional<unsigned short> metrics_port;
+    unsigned log_sample_rate = 1;
+    unsigned slow_request_threshold = 0;
+    unsigned io_shards = 0;
+    bool coroutine_sessions = false;
+    unsigned idle_timeout = 30;
+    bool release_idle_buffers = false;
+    size_t max_connections = 0;
+    bool compression = false;
+    int compression_level = 6;
+    size_t compression_min_size = 1024;
 };
 
 [[nodiscard]] std::optional<Args> ParseCommandLine(int argc, const char* const argv[]);
@@ -0,0 +1,206 @@
+#include "compression.h"
+
+#include <atomic>
+#include <cctype>
+#include <stdexcept>
+#include <zlib.h>
+
+namespace compression {
+
+using namespace std::literals;
+
+namespace {
+
+Settings settings;
+
+/* Размер окна zlib: 15 - формат zlib (deflate в HTTP), +16 - формат gzip */
+int GetWindowBits(Encoding encoding){
+    return encoding == Encoding::GZIP ? 15 + 16 : 15;
+}
+
+/* ------------------------ Deflater ----------------------------------- */
+
+/* Поток zlib, который переинициализируется только при смене уровня сжатия */
+class Deflater{
+public:
+    explicit Deflater(Encoding encoding)
+        : window_bits_(GetWindowBits(encoding)){}
+
+    Deflater(const Deflater&) = delete;
+    Deflater& operator=(const Deflater&) = delete;
+
+    ~Deflater(){
+        if(initialized_){
+            deflateEnd(&stream_);
+        }
+    }
+
+    void Compress(std::string_view input, std::string& output, int level){
+        Prepare(level);
+
+        output.resize(deflateBound(&stream_, static_cast<uLong>(input.size())));
+        stream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+        stream_.avail_in = static_cast<uInt>(input.size());
+        stream_.next_out = reinterpret_cast<Bytef*>(output.data());
+        stream_.avail_out = static_cast<uInt>(output.size());
+
+        /* Буфер размера deflateBound гарантирует завершение за один вызов */
+        if(deflate(&stream_, Z_FINISH) != Z_STREAM_END){
+            throw std::runtime_error("Failed to compress response body");
+        }
+        output.resize(stream_.total_out);
+    }
+private:
+    void Prepare(int level){
+        if(initialized_ && level == level_){
+            deflateReset(&stream_);
+            return;
+        }
+        if(initialized_){
+            deflateEnd(&stream_);
+            initialized_ = false;
+        }
+        stream_ = z_stream{};
+        if(deflateInit2(&stream_, level, Z_DEFLATED, window_bits_, 8, Z_DEFAULT_STRATEGY) != Z_OK){
+            throw std::runtime_error("Failed to initialize zlib stream");
+        }
+        initialized_ = true;
+        level_ = level;
+    }
+
+    z_stream stream_{};
+    int window_bits_;
+    int level_ = 0;
+    bool initialized_ = false;
+};
+
+Deflater& GetThreadDeflater(Encoding encoding){
+    thread_local Deflater gzip(Encoding::GZIP);
+    thread_local Deflater deflate(Encoding::DEFLATE);
+    return encoding == Encoding::GZIP ? gzip : deflate;
+}
+
+std::string_view Trim(std::string_view str){
+    const auto begin = str.find_first_not_of(" \t"sv);
+    if(begin == str.npos){
+        return {};
+    }
+    return str.substr(begin, str.find_last_not_of(" \t"sv) - begin + 1);
+}
+
+bool EqualsIgnoreCase(std::string_view lhs, std::string_view rhs){
+    if(lhs.size() != rhs.size()){
+        return false;
+    }
+    for(size_t i = 0; i < lhs.size(); ++i){
+        if(std::tolower(static_cast<unsigned char>(lhs[i])) != std::tolower(static_cast<unsigned char>(rhs[i]))){
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Кодирование с параметром q=0 явно запрещено клиентом */
+bool IsRejected(std::string_view params){
+    for(size_t pos = 0; pos < params.size();){
+        size_t end = params.find(';', pos);
+        std::string_view param = Trim(params.substr(pos, end == params.npos ? params.npos : end - pos));
+        if(param.size() > 2 && (param[0] == 'q' || param[0] == 'Q') && param[1] == '='){
+            return param.substr(2).find_first_not_of("0."sv) == std::string_view::npos;
+        }
+        if(end == params.npos){
+            break;
+        }
+        pos = end + 1;
+    }
+    return false;
+}
+
+} // namespace
+
+void Configure(const Settings& new_settings){
+    settings = new_settings;
+}
+
+const Settings& GetSettings(){
+    return settings;
+}
+
+Encoding NegotiateEncoding(std::string_view accept_encoding){
+    if(!settings.enabled){
+        return Encoding::IDENTITY;
+    }
+
+    bool gzip = false;
+    bool deflate = false;
+    for(size_t pos = 0; pos < accept_encoding.size();){
+        size_t end = accept_encoding.find(',', pos);
+        std::string_view item = accept_encoding.substr(pos, end == accept_encoding.npos ? accept_encoding.npos : end - pos);
+        size_t params = item.find(';');
+        std::string_view coding = Trim(item.substr(0, params));
+        if(params == item.npos || !IsRejected(item.substr(params + 1))){
+            gzip = gzip || EqualsIgnoreCase(coding, "gzip"sv) || coding == "*"sv;
+            deflate = deflate || EqualsIgnoreCase(coding, "deflate"sv);
+        }
+        if(end == accept_encoding.npos){
+            break;
+        }
+        pos = end + 1;
+    }
+
+    if(gzip){
+        return Encoding::GZIP;
+    }
+    return deflate ? Encoding::DEFLATE : Encoding::IDENTITY;
+}
+
+std::string_view GetEncodingName(Encoding encoding){
+    switch(encoding){
+        case Encoding::GZIP:    return "gzip"sv;
+        case Encoding::DEFLATE: return "deflate"sv;
+        default:                return "identity"sv;
+    }
+}
+
+void Compress(Encoding encoding, std::string_view input, std::string& output){
+    GetThreadDeflater(encoding).Compress(input, output, settings.level);
+}
+
+EncodedBody Encode(std::string body, Encoding accepted){
+    std::shared_ptr<std::string> result;
+    if(accepted == Encoding::IDENTITY || body.size() < settings.min_size){
+        result = std::make_shared<std::string>(std::move(body));
+        accepted = Encoding::IDENTITY;
+    } else {
+        result = std::make_shared<std::string>();
+        Compress(accepted, body, *result);
+    }
+    return {*result, accepted, std::move(result)};
+}
+
+std::shared_ptr<std::string>& PrepareCacheString(std::shared_ptr<std::string>& str){
+    if(str && str.use_count() == 1){
+        /* Ответы, читавшие строку в других потоках, уже отпустили ее */
+        std::atomic_thread_fence(std::memory_order_acquire);
+        str->clear();
+    } else {
+        str = std::make_shared<std::string>();
+    }
+    return str;
+}
+
+/* ------------------------ EncodedCache ----------------------------------- */
+
+EncodedBody EncodedCache::Get(const std::shared_ptr<const std::string>& body, Encoding accepted){
+    if(accepted == Encoding::IDENTITY || body->size() < settings.min_size){
+        return {*body, Encoding::IDENTITY, body};
+    }
+    const size_t index = accepted == Encoding::GZIP ? 0 : 1;
+    if(!ready_[index]){
+        Compress(accepted, *body, *PrepareCacheString(compressed_[index]));
+        ready_[index] = true;
+    }
+    return {*compressed_[index], accepted, compressed_[index]};
+}
+
+} // namespace compression
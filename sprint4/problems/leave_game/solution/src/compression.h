@@ -0,0 +1,84 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace compression {
+
+/* Кодирование тела ответа (Content-Encoding) */
+enum class Encoding{
+    IDENTITY,
+    GZIP,
+    DEFLATE
+};
+
+struct Settings{
+    bool enabled = false;
+    /* Уровень сжатия zlib: 1 - быстрее, 9 - плотнее */
+    int level = 6;
+    /* Тела меньшего размера не сжимаются: выигрыш меньше затрат */
+    size_t min_size = 1024;
+};
+
+/* Настройки задаются один раз при старте, до запуска рабочих потоков */
+void Configure(const Settings& settings);
+
+const Settings& GetSettings();
+
+/*
+    Выбирает кодирование по заголовку Accept-Encoding.
+    Предпочитается gzip, кодирования с q=0 не выбираются.
+    Если сжатие выключено, возвращает IDENTITY
+*/
+Encoding NegotiateEncoding(std::string_view accept_encoding);
+
+std::string_view GetEncodingName(Encoding encoding);
+
+/*
+    Сжимает input в output (содержимое output заменяется).
+    Состояние zlib свое у каждого потока и переиспользуется между вызовами
+*/
+void Compress(Encoding encoding, std::string_view input, std::string& output);
+
+/* Тело ответа вместе с его кодированием */
+struct EncodedBody{
+    std::string_view body;
+    Encoding encoding = Encoding::IDENTITY;
+    /* Строка, в которой лежит body. Ответы разделяют ее без копирования */
+    std::shared_ptr<const std::string> owner;
+};
+
+/* Сжимает тело, если клиент это принимает и тело не меньше порога */
+EncodedBody Encode(std::string body, Encoding accepted);
+
+/* ------------------------ EncodedCache ----------------------------------- */
+
+/*
+    Сжатые представления одного и того же тела.
+    Каждое кодирование вычисляется при первом запросе и переиспользуется
+    всеми клиентами до вызова Reset.
+    Память строки переиспользуется, если ее уже не удерживает ни один ответ
+*/
+class EncodedCache{
+public:
+    void Reset(){
+        ready_.fill(false);
+    }
+
+    EncodedBody Get(const std::shared_ptr<const std::string>& body, Encoding accepted);
+private:
+    static constexpr size_t ENCODINGS_COUNT = 2;
+
+    std::array<std::shared_ptr<std::string>, ENCODINGS_COUNT> compressed_;
+    std::array<bool, ENCODINGS_COUNT> ready_{};
+};
+
+/*
+    Строка для нового содержимого кеша: прежняя, если ее больше никто не удерживает,
+    иначе новая. Вызывается только владельцем кеша, поэтому use_count может лишь уменьшиться
+*/
+std::shared_ptr<std::string>& PrepareCacheString(std::shared_ptr<std::string>& str);
+
+} // namespace compression
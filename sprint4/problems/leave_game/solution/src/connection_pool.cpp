@@ -1,10 +1,12 @@
 #include "connection_pool.h"
+#include "metrics.h"
 
 namespace db_connection{
 
 /* ------------------------ ConnectionPool ----------------------------------- */
 
 ConnectionPool::ConnectionWrapper ConnectionPool::GetConnection(){
+    auto wait_start = metrics::Clock::now();
     std::unique_lock lock{mutex_};
     // Блокируем текущий поток и ждём, пока cond_var_ не получит уведомление и не освободится
     // хотя бы одно соединение
@@ -12,6 +14,7 @@ ConnectionPool::ConnectionWrapper ConnectionPool::GetConnection(){
         return used_connections_ < pool_.size();
     });
     // После выхода из цикла ожидания мьютекс остаётся захваченным
+    metrics::GetServerMetrics().db_pool_wait.Observe(metrics::ElapsedNs(wait_start));
 
     return {std::move(pool_[used_connections_++]), *this};
 }
@@ -1,7 +1,140 @@
 #include "http_server.h"
 
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
 namespace http_server {
 
-// Разместите здесь реализацию http-сервера, взяв её из задания по разработке асинхронного сервера
+namespace {
+
+/* Ядра, на которых процессу разрешено выполняться (с учетом cpuset контейнера) */
+std::vector<unsigned> GetAvailableCores() {
+    std::vector<unsigned> cores;
+#ifdef __linux__
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) == 0) {
+        for (unsigned core = 0; core < CPU_SETSIZE; ++core) {
+            if (CPU_ISSET(core, &cpu_set)) {
+                cores.push_back(core);
+            }
+        }
+    }
+#endif
+    if (cores.empty()) {
+        for (unsigned core = 0; core < std::max(1u, std::thread::hardware_concurrency()); ++core) {
+            cores.push_back(core);
+        }
+    }
+    return cores;
+}
+
+}  // namespace
+
+/* ------------------------ ConnectionContext ----------------------------------- */
+
+ConnectionContext::ConnectionContext(std::string remote_ip)
+    : remote_ip_(std::move(remote_ip)) {
+    metrics::GetServerMetrics().active_connections.Add(1);
+}
+
+ConnectionContext::~ConnectionContext() {
+    metrics::GetServerMetrics().active_connections.Add(-1);
+}
+
+void ConnectionContext::OnReadStart() {
+    trace_.Reset();
+    trace_.Mark(tracing::Stamp::READ_START);
+}
+
+void ConnectionContext::OnRequestRead(const HttpRequest& request) {
+    trace_.Mark(tracing::Stamp::PARSE_DONE);
+    // Запрос и ответ на него попадают в журнал вместе
+    is_logged_ = logger::ShouldLogRequest();
+    if (is_logged_) {
+        LOG_REQUEST_RECEIVED(remote_ip_, request.target(), request.method_string());
+    }
+    route_ = metrics::GetRoute(request.target());
+    // Буфер цели переиспользуется между запросами соединения
+    target_.assign(request.target());
+}
+
+void ConnectionContext::OnResponseWritten(const http::response_header<>& response, bool need_eof) {
+    trace_.Mark(tracing::Stamp::WRITE_DONE);
+    auto& server_metrics = metrics::GetServerMetrics();
+    server_metrics.GetRequests(route_).Add();
+    server_metrics.GetRequestLatency(route_).Observe(trace_.GetLatencyNs());
+    tracing::GetTraceRecorder().Record(route_, target_, trace_);
+
+    if (!need_eof && is_logged_) {
+        LOG_RESPONSE_SENT(remote_ip_, trace_.GetLatencyNs() / 1'000'000, static_cast<int>(response.result()),
+                          response.at(http::field::content_type));
+    }
+}
+
+void ConnectionContext::OnIdleStart() {
+    // Буфер цели нужен только во время запроса
+    target_.clear();
+    target_.shrink_to_fit();
+    metrics::GetServerMetrics().idle_connections.Add(1);
+}
+
+void ConnectionContext::OnIdleEnd() {
+    metrics::GetServerMetrics().idle_connections.Add(-1);
+}
+
+/* ------------------------ IoShards ----------------------------------- */
+
+IoShards::IoShards(unsigned count) {
+    contexts_.reserve(count);
+    for (unsigned i = 0; i < count; ++i) {
+        // Каждый io_context обслуживает ровно один поток
+        contexts_.push_back(std::make_unique<net::io_context>(1));
+    }
+}
+
+IoShards::~IoShards() {
+    Stop();
+    Join();
+}
+
+void IoShards::Start() {
+    const std::vector<unsigned> cores = GetAvailableCores();
+    threads_.reserve(contexts_.size());
+    for (unsigned i = 0; i < contexts_.size(); ++i) {
+        threads_.emplace_back([this, i, core = cores[i % cores.size()]] {
+            PinCurrentThreadToCore(core);
+            contexts_[i]->run();
+        });
+    }
+}
+
+void IoShards::Stop() {
+    for (auto& context : contexts_) {
+        context->stop();
+    }
+}
+
+void IoShards::Join() {
+    for (auto& thread : threads_) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    threads_.clear();
+}
+
+bool PinCurrentThreadToCore(unsigned core) {
+#ifdef __linux__
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(core, &cpu_set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) == 0;
+#else
+    return false;
+#endif
+}
 
 }  // namespace http_server
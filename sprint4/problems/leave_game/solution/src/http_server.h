@@ -3,12 +3,26 @@
 // boost.beast будет использовать std::string_view вместо boost::string_view
 #define BOOST_BEAST_USE_STD_STRING_VIEW
 
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
 #include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/steady_timer.hpp>
 #include <boost/asio/strand.hpp>
+#include <boost/asio/use_awaitable.hpp>
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
+#include <atomic>
+#include <chrono>
 #include <iostream>
+#include <memory>
+#include <thread>
+#include <variant>
+#include <vector>
 #include "logger.h"
+#include "metrics.h"
+#include "request_trace.h"
+#include "shared_body.h"
 
 namespace http_server {
 
@@ -23,6 +37,84 @@ inline void ReportError(beast::error_code ec, std::string_view what){
     LOG_ERROR(ec.value(), ec.message(), what);
 }
 
+/* ------------------------ ConnectionContext ----------------------------------- */
+
+using HttpRequest = http::request<http::string_body>;
+
+// Каждое соединение обслуживается в своем strand.
+// Executor конкретного типа, а не полиморфный any_io_executor:
+// копирование executor'а в каждой асинхронной операции не выделяет память
+using ConnectionStrand = net::strand<net::io_context::executor_type>;
+using ConnectionSocket = tcp::socket::rebind_executor<ConnectionStrand>::other;
+using ConnectionStream = beast::basic_stream<tcp, ConnectionStrand>;
+
+struct SessionOptions {
+    // Сколько соединение может простаивать между запросами и сколько читается один запрос
+    std::chrono::seconds idle_timeout{30};
+    // Между запросами буфер чтения освобождается, а чтение начинается с ожидания первого байта.
+    // Простаивающее keep-alive соединение не держит память под запрос
+    bool release_idle_buffers = false;
+};
+
+/*
+    Учет запросов одного соединения: журнал, метрики и трассировка.
+    Общий для сессии на обработчиках завершения и сессии на сопрограмме
+*/
+class ConnectionContext {
+public:
+    template <typename Socket>
+    explicit ConnectionContext(const Socket& socket)
+        : ConnectionContext(GetRemoteIp(socket)) {
+    }
+
+    ConnectionContext(const ConnectionContext&) = delete;
+    ConnectionContext& operator=(const ConnectionContext&) = delete;
+
+    ~ConnectionContext();
+
+    /* Начато чтение очередного запроса */
+    void OnReadStart();
+
+    /* Запрос прочитан: до передачи обработчику, так как запрос перемещается в него */
+    void OnRequestRead(const HttpRequest& request);
+
+    /* Ответ получен от обработчика и передается на запись */
+    void OnResponseReady() {
+        trace_.Mark(tracing::Stamp::SERIALIZATION_DONE);
+    }
+
+    /* Ответ записан. need_eof - соединение закрывается после ответа */
+    void OnResponseWritten(const http::response_header<>& response, bool need_eof);
+
+    /* Соединение ждет следующий запрос без буфера чтения */
+    void OnIdleStart();
+
+    /* Закончилось ожидание первого байта запроса */
+    void OnIdleEnd();
+
+    tracing::RequestTrace& GetTrace() {
+        return trace_;
+    }
+private:
+    explicit ConnectionContext(std::string remote_ip);
+
+    // Адрес клиента не меняется за время соединения, поэтому запрашиваем его один раз
+    template <typename Socket>
+    static std::string GetRemoteIp(const Socket& socket) {
+        beast::error_code ec;
+        auto endpoint = socket.remote_endpoint(ec);
+        return ec ? std::string{} : endpoint.address().to_string();
+    }
+
+    std::string remote_ip_;
+    bool is_logged_ = true;
+    metrics::Route route_ = metrics::Route::OTHER_API;
+    std::string target_;
+    tracing::RequestTrace trace_;
+};
+
+/* ------------------------ SessionBase ----------------------------------- */
+
 class SessionBase {
 public:
     // Запрещаем копирование и присваивание объектов SessionBase и его наследников
@@ -35,17 +127,20 @@ public:
                   beast::bind_front_handler(&SessionBase::Read, GetSharedThis()));
     }
 protected:
-    using HttpRequest = http::request<http::string_body>;
+    using HttpRequest = http_server::HttpRequest;
     using HttpResponse = http::response<http::string_body>;
 
-    explicit SessionBase(tcp::socket&& socket)
-        : stream_(std::move(socket)) {
+    SessionBase(ConnectionSocket&& socket, const SessionOptions& options)
+        : stream_(std::move(socket))
+        , context_(stream_.socket())
+        , options_(options) {
     }
 
     template <typename Body, typename Fields>
     void Write(http::response<Body, Fields>&& response) {
         // Запись выполняется асинхронно, поэтому response перемещаем в область кучи
         auto safe_response = std::make_shared<http::response<Body, Fields>>(std::move(response));
+        context_.OnResponseReady();
 
         auto self = GetSharedThis();
         http::async_write(stream_, *safe_response,
@@ -55,12 +150,43 @@ protected:
     }
 
     ~SessionBase() = default;
+
+    ConnectionStrand GetExecutor() {
+        return stream_.get_executor();
+    }
 private:
     void Read() {
-        using namespace std::literals;
         // Очищаем запрос от прежнего значения (метод Read может быть вызван несколько раз)
         request_ = {};
-        stream_.expires_after(30s);
+        // Если клиент уже прислал следующий запрос, он лежит в буфере и ждать нечего
+        if (!options_.release_idle_buffers || buffer_.size() > 0) {
+            return ReadRequest();
+        }
+        buffer_.shrink_to_fit();
+        context_.OnIdleStart();
+        stream_.expires_after(options_.idle_timeout);
+        stream_.async_read_some(net::buffer(&first_byte_, 1),
+                                beast::bind_front_handler(&SessionBase::OnIdleRead, GetSharedThis()));
+    }
+
+    void OnIdleRead(beast::error_code ec, std::size_t bytes_read) {
+        using namespace std::literals;
+        context_.OnIdleEnd();
+        if (ec == net::error::eof) {
+            // Нормальная ситуация - клиент закрыл соединение
+            return Close();
+        }
+        if (ec) {
+            return ReportError(ec, "read"sv);
+        }
+        // Буфер выделяется только теперь, когда пришли данные запроса
+        buffer_.commit(net::buffer_copy(buffer_.prepare(bytes_read), net::buffer(&first_byte_, bytes_read)));
+        ReadRequest();
+    }
+
+    void ReadRequest() {
+        context_.OnReadStart();
+        stream_.expires_after(options_.idle_timeout);
         // Считываем request_ из stream_, используя buffer_ для хранения считанных данных
         http::async_read(stream_, buffer_, request_,
                          // По окончании операции будет вызван метод OnRead
@@ -77,11 +203,7 @@ private:
             LOG_ERROR(ec.value(), ec.message(), "read");
             return ReportError(ec, "read"sv);
         }
-        std::string ip(stream_.socket().remote_endpoint().address().to_string());
-        std::string url(request_.target());
-        std::string method(request_.method_string());
-        LOG_REQUEST_RECEIVED(ip, url, method);
-        response_timer_.Start();
+        context_.OnRequestRead(request_);
         HandleRequest(std::move(request_));
     }
 
@@ -93,13 +215,12 @@ private:
             return ReportError(ec, "write"sv);
         }
 
-        if (safe_response->need_eof()) {
+        const bool need_eof = safe_response->need_eof();
+        context_.OnResponseWritten(*safe_response, need_eof);
+        if (need_eof) {
             // Семантика ответа требует закрыть соединение
             return Close();
         }
-        std::string ip(stream_.socket().remote_endpoint().address().to_string());
-        std::string content_type(safe_response->at(http::field::content_type));
-        LOG_RESPONSE_SENT(ip, response_timer_.End(), static_cast<int>(safe_response->result()), content_type);
 
         // Считываем следующий запрос
         Read();
@@ -113,21 +234,28 @@ private:
 
     // Обработку запроса делегируем подклассу
     virtual void HandleRequest(HttpRequest&& request) = 0;
+protected:
+    tracing::RequestTrace& GetTrace(){
+        return context_.GetTrace();
+    }
+private:
 
     virtual std::shared_ptr<SessionBase> GetSharedThis() = 0;
-    // tcp_stream содержит внутри себя сокет и добавляет поддержку таймаутов
-    beast::tcp_stream stream_;
+    // Поток содержит внутри себя сокет и добавляет поддержку таймаутов
+    ConnectionStream stream_;
     beast::flat_buffer buffer_;
     HttpRequest request_;
-    logger::Timer response_timer_;
+    ConnectionContext context_;
+    SessionOptions options_;
+    char first_byte_ = 0;
 };
 
 template <typename RequestHandler>
 class Session : public SessionBase, public std::enable_shared_from_this<Session<RequestHandler>> {
 public:
     template <typename Handler>
-    Session(tcp::socket&& socket, Handler&& request_handler)
-        : SessionBase(std::move(socket))
+    Session(ConnectionSocket&& socket, const SessionOptions& options, Handler&& request_handler)
+        : SessionBase(std::move(socket), options)
         , request_handler_(std::forward<Handler>(request_handler)) {
     }
 private:
@@ -135,9 +263,14 @@ private:
         // Захватываем умный указатель на текущий объект Session в лямбде,
         // чтобы продлить время жизни сессии до вызова лямбды.
         // Используется generic-лямбда функция, способная принять response произвольного типа
+        // Обработчик проставляет в контексте трассировки отметки этапов, через которые прошел запрос
         request_handler_(std::move(request), [self = this->shared_from_this()](auto&& response) {
-            self->Write(std::move(response));
-        });
+            // Ответ может прийти из потока симуляции игры: запись выполняется в strand соединения.
+            // Если обработчик ответил сразу, dispatch вызывает Write без постановки в очередь
+            net::dispatch(self->GetExecutor(), [self, response = std::move(response)]() mutable {
+                self->Write(std::move(response));
+            });
+        }, GetTrace());
     }
 
     std::shared_ptr<SessionBase> GetSharedThis() override{
@@ -147,15 +280,199 @@ private:
     RequestHandler request_handler_;
 };
 
+/* ------------------------ Coroutine session ----------------------------------- */
+
+/*
+    Передача ответа от обработчика в сопрограмму соединения.
+    Если обработчик ответил сразу, сопрограмма не приостанавливается.
+    Иначе send вызывается в другом потоке (например, в strand игрового API),
+    и сопрограмма ждет таймер, который отменяется в executor'е соединения.
+    Ожидание ограничено по времени: обработчик, так и не ответивший, не должен держать соединение
+*/
+class ResponseSlot : public std::enable_shared_from_this<ResponseSlot> {
+public:
+    using Executor = ConnectionStrand;
+    using Response = std::variant<http::response<http::string_body>, SharedResponse, http::response<http::file_body>>;
+
+    explicit ResponseSlot(const Executor& executor)
+        : ready_(executor, net::steady_timer::time_point::max()) {
+    }
+
+    template <typename Body>
+    void Deliver(http::response<Body>&& response) {
+        response_ = std::move(response);
+        if (state_.exchange(State::READY, std::memory_order_acq_rel) == State::WAITING) {
+            // Отмена выполняется в executor'е соединения уже после того, как сопрограмма начала ждать.
+            // Сопрограмма могла перестать ждать по таймауту, поэтому слот удерживается до отмены
+            net::post(ready_.get_executor(), [self = shared_from_this()] {
+                self->ready_.cancel();
+            });
+        }
+    }
+
+    /* Забирает готовый ответ. Если его еще нет, дальше нужно вызвать Wait */
+    bool TryTake() {
+        State expected = State::EMPTY;
+        if (state_.compare_exchange_strong(expected, State::WAITING, std::memory_order_acq_rel)) {
+            return false;
+        }
+        state_.store(State::EMPTY, std::memory_order_relaxed);
+        return true;
+    }
+
+    /*
+        Дожидается ответа не дольше timeout. Вызывается в executor'е соединения после TryTake.
+        Возвращает false, если ответ не пришел: соединение нужно закрыть
+    */
+    net::awaitable<bool, Executor> Wait(std::chrono::steady_clock::duration timeout) {
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (state_.load(std::memory_order_acquire) == State::WAITING) {
+            if (std::chrono::steady_clock::now() >= deadline) {
+                State expected = State::WAITING;
+                if (state_.compare_exchange_strong(expected, State::EMPTY, std::memory_order_acq_rel)) {
+                    co_return false;
+                }
+                break;
+            }
+            // Пробуждение до срока без ответа - отмена, запоздавшая от ответа, пришедшего после таймаута
+            sys::error_code ec;
+            ready_.expires_at(deadline);
+            co_await ready_.async_wait(net::redirect_error(net::use_awaitable_t<Executor>{}, ec));
+        }
+        ready_.expires_at(net::steady_timer::time_point::max());
+        state_.store(State::EMPTY, std::memory_order_relaxed);
+        co_return true;
+    }
+
+    Response& GetResponse() {
+        return response_;
+    }
+private:
+    enum class State {
+        EMPTY,
+        WAITING,
+        READY
+    };
+
+    std::atomic<State> state_{State::EMPTY};
+    net::basic_waitable_timer<std::chrono::steady_clock, net::wait_traits<std::chrono::steady_clock>, Executor> ready_;
+    Response response_;
+};
+
+/*
+    Сессия в виде одной сопрограммы на соединение.
+    Поток, буфер и запрос живут в кадре сопрограммы, ответ - в ResponseSlot,
+    создаваемом один раз на соединение, а не на каждую асинхронную операцию.
+    Кадры сопрограмм asio выделяются через кеш памяти потока и переиспользуются
+*/
+template <typename RequestHandler>
+net::awaitable<void, ConnectionStrand> RunCoroutineSession(ConnectionSocket socket, SessionOptions options,
+                                                           RequestHandler request_handler) {
+    using namespace std::literals;
+    using Executor = ConnectionStrand;
+    constexpr net::use_awaitable_t<Executor> use_awaitable;
+
+    ConnectionStream stream(std::move(socket));
+    beast::flat_buffer buffer;
+    ConnectionContext context(stream.socket());
+    // Обработчик может ответить после завершения сопрограммы, поэтому слот ответа разделяемый
+    auto slot = std::make_shared<ResponseSlot>(stream.get_executor());
+    beast::error_code ec;
+
+    for (;;) {
+        if (options.release_idle_buffers && buffer.size() == 0) {
+            // Между запросами буфер не занимает память: ждем первый байт следующего запроса
+            buffer.shrink_to_fit();
+            char first_byte = 0;
+            context.OnIdleStart();
+            stream.expires_after(options.idle_timeout);
+            const size_t bytes_read = co_await stream.async_read_some(net::buffer(&first_byte, 1),
+                                                                      net::redirect_error(use_awaitable, ec));
+            context.OnIdleEnd();
+            if (ec == net::error::eof) {
+                break;
+            }
+            if (ec) {
+                ReportError(ec, "read"sv);
+                co_return;
+            }
+            buffer.commit(net::buffer_copy(buffer.prepare(bytes_read), net::buffer(&first_byte, bytes_read)));
+        }
+
+        HttpRequest request;
+        context.OnReadStart();
+        stream.expires_after(options.idle_timeout);
+        co_await http::async_read(stream, buffer, request, net::redirect_error(use_awaitable, ec));
+        if (ec == http::error::end_of_stream) {
+            // Нормальная ситуация - клиент закрыл соединение
+            break;
+        }
+        if (ec) {
+            ReportError(ec, "read"sv);
+            co_return;
+        }
+
+        context.OnRequestRead(request);
+        request_handler(std::move(request), [slot](auto&& response) {
+            slot->Deliver(std::move(response));
+        }, context.GetTrace());
+        if (!slot->TryTake() && !co_await slot->Wait(options.idle_timeout)) {
+            ReportError(beast::error::timeout, "handler"sv);
+            co_return;
+        }
+        context.OnResponseReady();
+
+        auto& response = slot->GetResponse();
+        const bool need_eof = std::visit([](const auto& message) {
+            return message.need_eof();
+        }, response);
+        co_await std::visit([&](auto& message) {
+            return http::async_write(stream, message, net::redirect_error(use_awaitable, ec));
+        }, response);
+        if (!ec) {
+            std::visit([&](const auto& message) {
+                context.OnResponseWritten(message, need_eof);
+            }, response);
+        }
+        // Освобождаем тело ответа, пока соединение ждет следующий запрос
+        response = {};
+        if (ec) {
+            ReportError(ec, "write"sv);
+            co_return;
+        }
+        if (need_eof) {
+            // Семантика ответа требует закрыть соединение
+            break;
+        }
+    }
+
+    stream.socket().shutdown(tcp::socket::shutdown_send, ec);
+    ReportError(ec, "close"sv);
+}
+
+/* ------------------------ Listener ----------------------------------- */
+
+struct ListenerOptions {
+    // Несколько acceptor'ов на одном порту (режим шардов)
+    bool reuse_port = false;
+    // Сессия на сопрограмме вместо сессии на обработчиках завершения
+    bool coroutine_sessions = false;
+    // Предел открытых соединений процесса, 0 - без ограничения.
+    // Сверх предела соединения закрываются сразу после приема
+    size_t max_connections = 0;
+    SessionOptions session;
+};
+
 template <typename RequestHandler>
 class Listener : public std::enable_shared_from_this<Listener<RequestHandler>> {
 public:
     template <typename Handler>
-    Listener(net::io_context& ioc, const tcp::endpoint& endpoint, Handler&& request_handler)
+    Listener(net::io_context& ioc, const tcp::endpoint& endpoint, Handler&& request_handler, ListenerOptions options = {})
         : ioc_(ioc)
         // Обработчики асинхронных операций acceptor_ будут вызываться в своём strand
         , acceptor_(net::make_strand(ioc))
-        , request_handler_(std::forward<Handler>(request_handler)) {
+        , request_handler_(std::forward<Handler>(request_handler))
+        , options_(options) {
         // Открываем acceptor, используя протокол (IPv4 или IPv6), указанный в endpoint
         acceptor_.open(endpoint.protocol());
 
@@ -164,6 +481,11 @@ public:
         // Однако это может помешать повторно открыть сокет в полузакрытом состоянии.
         // Флаг reuse_address разрешает открыть сокет, когда он "наполовину закрыт"
         acceptor_.set_option(net::socket_base::reuse_address(true));
+        // В режиме шардов на одном порту слушают несколько acceptor'ов,
+        // и ядро само распределяет входящие соединения между ними
+        if (options_.reuse_port) {
+            acceptor_.set_option(ReusePort(true));
+        }
         // Привязываем acceptor к адресу и порту endpoint
         acceptor_.bind(endpoint);
         // Переводим acceptor в состояние, в котором он способен принимать новые соединения
@@ -176,6 +498,8 @@ public:
     }
 
 private:
+    using ReusePort = net::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+
     void DoAccept() {
         acceptor_.async_accept(
             // Передаём последовательный исполнитель, в котором будут вызываться обработчики
@@ -193,36 +517,106 @@ private:
     }
 
     // Метод socket::async_accept создаст сокет и передаст его передан в OnAccept
-    void OnAccept(sys::error_code ec, tcp::socket socket) {
+    void OnAccept(sys::error_code ec, ConnectionSocket socket) {
         using namespace std::literals;
 
         if (ec) {
             return ReportError(ec, "accept"sv);
         }
 
-        // Асинхронно обрабатываем сессию
-        AsyncRunSession(std::move(socket));
+        if (IsConnectionLimitReached()) {
+            metrics::GetServerMetrics().rejected_connections.Add();
+            socket.close(ec);
+        } else {
+            // Асинхронно обрабатываем сессию
+            AsyncRunSession(std::move(socket));
+        }
 
         // Принимаем новое соединение
         DoAccept();
     }
 
-    void AsyncRunSession(tcp::socket&& socket) {
-        std::make_shared<Session<RequestHandler>>(std::move(socket), request_handler_)->Run();
+    // Счетчик общий для всех шардов, поэтому предел может быть превышен на число одновременно принимаемых соединений
+    bool IsConnectionLimitReached() const {
+        return options_.max_connections > 0
+            && metrics::GetServerMetrics().active_connections.Get() >= static_cast<int64_t>(options_.max_connections);
+    }
+
+    void AsyncRunSession(ConnectionSocket&& socket) {
+        if (options_.coroutine_sessions) {
+            // Сопрограмма выполняется в strand, с которым был принят сокет
+            auto executor = socket.get_executor();
+            net::co_spawn(executor, RunCoroutineSession(std::move(socket), options_.session, request_handler_),
+                          net::detached);
+            return;
+        }
+        std::make_shared<Session<RequestHandler>>(std::move(socket), options_.session, request_handler_)->Run();
     }
 
     net::io_context& ioc_;
     tcp::acceptor acceptor_;
     RequestHandler request_handler_;
+    ListenerOptions options_;
 };
 
 template <typename RequestHandler>
-void ServeHttp(net::io_context& ioc, const tcp::endpoint& endpoint, RequestHandler&& handler) {
+void ServeHttp(net::io_context& ioc, const tcp::endpoint& endpoint, RequestHandler&& handler, ListenerOptions options = {}) {
     // При помощи decay_t исключим ссылки из типа RequestHandler,
     // чтобы Listener хранил RequestHandler по значению
     using MyListener = Listener<std::decay_t<RequestHandler>>;
 
-    std::make_shared<MyListener>(ioc, endpoint, std::forward<RequestHandler>(handler))->Run();
+    std::make_shared<MyListener>(ioc, endpoint, std::forward<RequestHandler>(handler), options)->Run();
+}
+
+/* ------------------------ IoShards ----------------------------------- */
+
+/*
+    Набор независимых io_context, по одному на ядро.
+    Каждый шард обслуживается одним потоком, закрепленным за своим ядром,
+    и принимает соединения своим acceptor'ом с SO_REUSEPORT.
+    Соединение обрабатывается целиком на принявшем его шарде,
+    поэтому обработчики не переходят между потоками внутри io_context.
+*/
+class IoShards {
+public:
+    explicit IoShards(unsigned count);
+
+    IoShards(const IoShards&) = delete;
+    IoShards& operator=(const IoShards&) = delete;
+
+    ~IoShards();
+
+    unsigned Size() const {
+        return static_cast<unsigned>(contexts_.size());
+    }
+
+    net::io_context& Get(unsigned index) {
+        return *contexts_[index];
+    }
+
+    /* Запускает по одному потоку на шард */
+    void Start();
+
+    void Stop();
+
+    /* Дожидается завершения потоков шардов */
+    void Join();
+private:
+    std::vector<std::unique_ptr<net::io_context>> contexts_;
+    std::vector<std::jthread> threads_;
+};
+
+/* Закрепляет текущий поток за ядром. Возвращает false, если это не поддерживается */
+bool PinCurrentThreadToCore(unsigned core);
+
+/* Запускает сервер на каждом шарде с отдельным acceptor'ом на общем порту */
+template <typename RequestHandler>
+void ServeHttpSharded(IoShards& shards, const tcp::endpoint& endpoint, const RequestHandler& handler,
+                      ListenerOptions options = {}) {
+    options.reuse_port = true;
+    for (unsigned i = 0; i < shards.Size(); ++i) {
+        ServeHttp(shards.Get(i), endpoint, handler, options);
+    }
 }
 
 }  // namespace http_server
@@ -0,0 +1,145 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+
+namespace util {
+
+/* ------------------------ InlineVector ----------------------------------- */
+
+/*
+    Последовательность, первые N элементов которой хранятся внутри объекта.
+    Пока размер не больше N, память в куче не выделяется. При превышении N
+    элементы переносятся в std::vector и остаются там до очистки.
+    Интерфейс повторяет стандартные контейнеры, чтобы подходить для range-for и алгоритмов.
+    T - простой тип значения: конструируется по умолчанию и копируется
+*/
+template <typename T, size_t N>
+class InlineVector{
+public:
+    static_assert(N > 0, "Inline capacity must be positive");
+
+    using value_type = T;
+    using size_type = size_t;
+    using reference = T&;
+    using const_reference = const T&;
+    using iterator = T*;
+    using const_iterator = const T*;
+
+    InlineVector() = default;
+
+    InlineVector(std::initializer_list<T> items)
+        : InlineVector(items.begin(), items.end()){}
+
+    template <typename It>
+    InlineVector(It first, It last){
+        for(; first != last; ++first){
+            push_back(*first);
+        }
+    }
+
+    static constexpr size_t inline_capacity() noexcept{
+        return N;
+    }
+
+    /* Элементы вынесены в кучу */
+    bool spilled() const noexcept{
+        return size_ > N;
+    }
+
+    size_t size() const noexcept{
+        return size_;
+    }
+
+    bool empty() const noexcept{
+        return size_ == 0;
+    }
+
+    T* data() noexcept{
+        return spilled() ? spill_.data() : inline_.data();
+    }
+
+    const T* data() const noexcept{
+        return spilled() ? spill_.data() : inline_.data();
+    }
+
+    iterator begin() noexcept{
+        return data();
+    }
+
+    iterator end() noexcept{
+        return data() + size_;
+    }
+
+    const_iterator begin() const noexcept{
+        return data();
+    }
+
+    const_iterator end() const noexcept{
+        return data() + size_;
+    }
+
+    T& operator[](size_t index) noexcept{
+        return data()[index];
+    }
+
+    const T& operator[](size_t index) const noexcept{
+        return data()[index];
+    }
+
+    void push_back(const T& value){
+        emplace_back(value);
+    }
+
+    void push_back(T&& value){
+        emplace_back(std::move(value));
+    }
+
+    template <typename... Args>
+    T& emplace_back(Args&&... args){
+        /* Аргументы могут ссылаться на элементы самого контейнера, поэтому значение создается до переноса */
+        T value(std::forward<Args>(args)...);
+        if(size_ < N){
+            inline_[size_] = std::move(value);
+        } else {
+            if(size_ == N){
+                spill_.reserve(N * 2);
+                spill_.assign(std::make_move_iterator(inline_.begin()), std::make_move_iterator(inline_.end()));
+            }
+            spill_.push_back(std::move(value));
+        }
+        ++size_;
+        return data()[size_ - 1];
+    }
+
+    void pop_back() noexcept{
+        if(spilled()){
+            spill_.pop_back();
+            if(size_ - 1 == N){
+                std::move(spill_.begin(), spill_.end(), inline_.begin());
+                spill_.clear();
+            }
+        }
+        --size_;
+    }
+
+    /* Память в куче, если она была выделена, остается за контейнером для следующего переноса */
+    void clear() noexcept{
+        spill_.clear();
+        size_ = 0;
+    }
+
+    friend bool operator==(const InlineVector& lhs, const InlineVector& rhs){
+        return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+    }
+private:
+    std::array<T, N> inline_{};
+    std::vector<T> spill_;
+    uint32_t size_ = 0;
+};
+
+} // namespace util
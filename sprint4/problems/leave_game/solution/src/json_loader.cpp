@@ -1,5 +1,6 @@
 #include "json_loader.h"
 
+#include <cmath>
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -110,6 +111,15 @@ void AddMaps(const json::array& json_maps, Game& game){
             if(auto it = json_map.find("bagCapacity"); it != json_map.end()){
                 bag_cap = it->value().as_int64();
             }
+
+            if(auto it = json_map.find("interestRadius"); it != json_map.end()){
+                const json::value& radius = it->value();
+                const double interest_radius = radius.is_double() ? radius.as_double() : static_cast<double>(radius.as_int64());
+                if(!std::isfinite(interest_radius) || !(interest_radius > 0)){
+                    throw std::invalid_argument("interestRadius of map " + *map.GetId() + " must be a positive number");
+                }
+                map.SetInterestRadius(interest_radius);
+            }
         } catch(std::exception& ex){
             std::cerr << ex.what() << std::endl;
         }
@@ -133,6 +143,9 @@ void LoadConfig(std::string json_str, Game& game){
         if(auto it = attributes.find("dogRetirementTime"); it != attributes.end()){
             game.SetDogRetirementTime(static_cast<unsigned>(it->value().as_double()));
         }
+        if(auto it = attributes.find("sessionRetirementTime"); it != attributes.end()){
+            game.SetSessionRetirementTime(it->value().as_double());
+        }
         if(auto it = attributes.find("defaultBagCapacity"); it != attributes.end()){
             game.SetDefaultBagCapacity(it->value().as_int64());
         }
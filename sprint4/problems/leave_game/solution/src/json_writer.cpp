@@ -0,0 +1,209 @@
+#include "json_writer.h"
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace json_writer {
+
+using namespace std::literals;
+
+/* ------------------------ FormatDouble ----------------------------------- */
+
+size_t FormatDouble(char* dest, double value){
+    /* Специальные значения записываются так же, как в Ryu */
+    if(std::isnan(value)){
+        std::memcpy(dest, "NaN", 3);
+        return 3;
+    }
+    if(std::isinf(value)){
+        if(value < 0){
+            std::memcpy(dest, "-Infinity", 9);
+            return 9;
+        }
+        std::memcpy(dest, "Infinity", 8);
+        return 8;
+    }
+
+    /*
+        std::to_chars без указания точности выдает кратчайшее представление,
+        которое однозначно восстанавливается в исходное число - те же цифры, что и у Ryu.
+        Остается привести экспоненту к виду Ryu: "4.22e+01" -> "4.22E1"
+    */
+    char* end = std::to_chars(dest, dest + MAX_DOUBLE_LENGTH, value, std::chars_format::scientific).ptr;
+    char* exp = static_cast<char*>(std::memchr(dest, 'e', end - dest));
+
+    char* out = exp;
+    *out++ = 'E';
+    const char* in = exp + 1;
+    if(*in == '-'){
+        *out++ = '-';
+    }
+    ++in;
+    /* Убираем ведущие нули экспоненты, оставляя хотя бы одну цифру */
+    while(in + 1 < end && *in == '0'){
+        ++in;
+    }
+    while(in < end){
+        *out++ = *in++;
+    }
+
+    return out - dest;
+}
+
+/* ------------------------ JsonWriter ----------------------------------- */
+
+JsonWriter& JsonWriter::StartObject(){
+    BeforeValue();
+    buffer_.push_back('{');
+    Push();
+    return *this;
+}
+
+JsonWriter& JsonWriter::EndObject(){
+    Pop();
+    buffer_.push_back('}');
+    return *this;
+}
+
+JsonWriter& JsonWriter::StartArray(){
+    BeforeValue();
+    buffer_.push_back('[');
+    Push();
+    return *this;
+}
+
+JsonWriter& JsonWriter::EndArray(){
+    Pop();
+    buffer_.push_back(']');
+    return *this;
+}
+
+JsonWriter& JsonWriter::Key(std::string_view key){
+    BeforeValue();
+    WriteEscaped(key);
+    buffer_.push_back(':');
+    after_key_ = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::Key(uint64_t key){
+    BeforeValue();
+    char buf[24];
+    char* end = std::to_chars(buf, buf + sizeof(buf), key).ptr;
+    buffer_.push_back('"');
+    buffer_.append(buf, end);
+    buffer_.append("\":"sv);
+    after_key_ = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::String(std::string_view value){
+    BeforeValue();
+    WriteEscaped(value);
+    return *this;
+}
+
+JsonWriter& JsonWriter::Int(int64_t value){
+    BeforeValue();
+    char buf[24];
+    char* end = std::to_chars(buf, buf + sizeof(buf), value).ptr;
+    buffer_.append(buf, end);
+    return *this;
+}
+
+JsonWriter& JsonWriter::Uint(uint64_t value){
+    BeforeValue();
+    char buf[24];
+    char* end = std::to_chars(buf, buf + sizeof(buf), value).ptr;
+    buffer_.append(buf, end);
+    return *this;
+}
+
+JsonWriter& JsonWriter::Double(double value){
+    BeforeValue();
+    char buf[MAX_DOUBLE_LENGTH];
+    buffer_.append(buf, FormatDouble(buf, value));
+    return *this;
+}
+
+JsonWriter& JsonWriter::Bool(bool value){
+    BeforeValue();
+    buffer_.append(value ? "true"sv : "false"sv);
+    return *this;
+}
+
+JsonWriter& JsonWriter::Null(){
+    BeforeValue();
+    buffer_.append("null"sv);
+    return *this;
+}
+
+JsonWriter& JsonWriter::Pair(double x, double y){
+    StartArray();
+    Double(x);
+    Double(y);
+    return EndArray();
+}
+
+void JsonWriter::BeforeValue(){
+    if(after_key_){
+        /* Значение сразу после ключа - запятая не нужна */
+        after_key_ = false;
+        return;
+    }
+    if(depth_ == 0){
+        return;
+    }
+    const uint64_t bit = uint64_t{1} << (depth_ - 1);
+    if(has_elements_ & bit){
+        buffer_.push_back(',');
+    } else {
+        has_elements_ |= bit;
+    }
+}
+
+void JsonWriter::Push(){
+    if(depth_ >= MAX_DEPTH){
+        throw std::logic_error("JSON nesting is too deep");
+    }
+    ++depth_;
+    has_elements_ &= ~(uint64_t{1} << (depth_ - 1));
+}
+
+void JsonWriter::Pop(){
+    --depth_;
+}
+
+void JsonWriter::WriteEscaped(std::string_view str){
+    static constexpr char HEX[] = "0123456789abcdef";
+
+    buffer_.push_back('"');
+    size_t plain_start = 0;
+    for(size_t i = 0; i < str.size(); ++i){
+        unsigned char c = static_cast<unsigned char>(str[i]);
+        if(c >= 0x20 && c != '"' && c != '\\'){
+            continue;
+        }
+        /* Копируем накопленный участок без экранирования одним вызовом */
+        buffer_.append(str.data() + plain_start, i - plain_start);
+        plain_start = i + 1;
+        switch(c){
+            case '"':  buffer_.append("\\\""sv); break;
+            case '\\': buffer_.append("\\\\"sv); break;
+            case '\b': buffer_.append("\\b"sv); break;
+            case '\f': buffer_.append("\\f"sv); break;
+            case '\n': buffer_.append("\\n"sv); break;
+            case '\r': buffer_.append("\\r"sv); break;
+            case '\t': buffer_.append("\\t"sv); break;
+            default:
+                buffer_.append("\\u00"sv);
+                buffer_.push_back(HEX[c >> 4]);
+                buffer_.push_back(HEX[c & 0xf]);
+        }
+    }
+    buffer_.append(str.data() + plain_start, str.size() - plain_start);
+    buffer_.push_back('"');
+}
+
+} // namespace json_writer
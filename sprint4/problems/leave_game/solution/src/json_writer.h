@@ -0,0 +1,86 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace json_writer {
+
+/*
+    Потоковый сериализатор JSON.
+    Пишет сразу в переданный строковый буфер, не строя дерево json::value.
+    Формат вывода побайтово совпадает с json::serialize из Boost.JSON:
+    - числа с плавающей точкой записываются в кратчайшем виде
+      в экспоненциальной форме (4.22E1, 1E0, 5E-1), как это делает Ryu;
+    - управляющие символы строк экранируются так же, как в Boost.JSON.
+
+    Буфер не очищается, поэтому один и тот же буфер
+    можно переиспользовать между ответами, сохраняя выделенную память.
+*/
+class JsonWriter{
+public:
+    explicit JsonWriter(std::string& buffer)
+        : buffer_(buffer){}
+
+    JsonWriter(const JsonWriter&) = delete;
+    JsonWriter& operator=(const JsonWriter&) = delete;
+
+    JsonWriter& StartObject();
+
+    JsonWriter& EndObject();
+
+    JsonWriter& StartArray();
+
+    JsonWriter& EndArray();
+
+    JsonWriter& Key(std::string_view key);
+
+    /* Числовой ключ записывается без промежуточного std::to_string */
+    JsonWriter& Key(uint64_t key);
+
+    JsonWriter& String(std::string_view value);
+
+    JsonWriter& Int(int64_t value);
+
+    JsonWriter& Uint(uint64_t value);
+
+    JsonWriter& Double(double value);
+
+    JsonWriter& Bool(bool value);
+
+    JsonWriter& Null();
+
+    /* Пара чисел в виде массива [x, y] */
+    JsonWriter& Pair(double x, double y);
+
+    std::string& GetBuffer(){
+        return buffer_;
+    }
+private:
+    static constexpr size_t MAX_DEPTH = 64;
+
+    /* Ставит запятую перед очередным элементом, если он не первый */
+    void BeforeValue();
+
+    void Push();
+
+    void Pop();
+
+    void WriteEscaped(std::string_view str);
+
+    std::string& buffer_;
+    /* Бит уровня вложенности выставлен, если на этом уровне уже был элемент */
+    uint64_t has_elements_ = 0;
+    size_t depth_ = 0;
+    bool after_key_ = false;
+};
+
+/*
+    Записывает число в формате Boost.JSON (Ryu) в dest.
+    В dest должно быть не меньше MAX_DOUBLE_LENGTH байт.
+    Возвращает количество записанных символов.
+*/
+inline constexpr size_t MAX_DOUBLE_LENGTH = 32;
+
+size_t FormatDouble(char* dest, double value);
+
+} // namespace json_writer
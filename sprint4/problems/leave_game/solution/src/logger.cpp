@@ -13,8 +13,15 @@ std::ostream& operator<<(std::ostream& out, LOG_MESSAGES msg){
 
 BOOST_LOG_ATTRIBUTE_KEYWORD(additional_data, "AdditionalData", json::value)
 BOOST_LOG_ATTRIBUTE_KEYWORD(timestamp, "TimeStamp", boost::posix_time::ptime)
+BOOST_LOG_ATTRIBUTE_KEYWORD(preformatted, "Preformatted", bool)
 
 void JSONFormatter(logging::record_view const& rec, logging::formatting_ostream& strm) {
+    /* Пачка строк, уже отформатированных AsyncLogger */
+    if(rec[preformatted]){
+        strm << *rec[logging::expressions::smessage];
+        return;
+    }
+
     json::object log;
 
     log.emplace("timestamp", to_iso_extended_string(*rec[timestamp]));
@@ -36,6 +43,7 @@ void FileConfig(){
         // ротируем ежедневно в полдень
         keywords::time_based_rotation = logging::sinks::file::rotation_at_time_point(12, 0, 0)
     );
+    AsyncLogger::Instance().Start();
 }
 
 void ConsoleConfig(){
@@ -45,11 +53,50 @@ void ConsoleConfig(){
         keywords::format = &JSONFormatter,
         keywords::auto_flush = true
     );
+    AsyncLogger::Instance().Start();
 }
 
 void Log(const json::value& data, LOG_MESSAGES message){
+    /* Перед записью о завершении дописываем накопленные записи о запросах */
+    if(message == LOG_MESSAGES::SERVER_EXITED){
+        AsyncLogger::Instance().Stop();
+    }
     BOOST_LOG_TRIVIAL(info) << logging::add_value(additional_data, data)
                             << message;
 }
 
+void WriteBatch(const std::string& batch){
+    BOOST_LOG_TRIVIAL(info) << logging::add_value(preformatted, true)
+                            << batch;
+}
+
+void LogRequestReceived(std::string_view ip, std::string_view url, std::string_view method){
+    AsyncRecord record;
+    record.kind = AsyncRecord::Kind::REQUEST_RECEIVED;
+    record.timestamp = std::chrono::system_clock::now();
+    record.ip.Assign(ip);
+    record.url.Assign(url);
+    record.method.Assign(method);
+    AsyncLogger::Instance().Push(record);
+}
+
+void LogResponseSent(std::string_view ip, size_t response_time, int code, std::string_view content_type){
+    AsyncRecord record;
+    record.kind = AsyncRecord::Kind::RESPONSE_SENT;
+    record.timestamp = std::chrono::system_clock::now();
+    record.ip.Assign(ip);
+    record.response_time = response_time;
+    record.code = code;
+    record.content_type.Assign(content_type);
+    AsyncLogger::Instance().Push(record);
+}
+
+void SetRequestLogSampling(unsigned rate){
+    AsyncLogger::Instance().SetSampleRate(rate);
+}
+
+bool ShouldLogRequest(){
+    return AsyncLogger::Instance().SampleRequest();
+}
+
 }; // namespace logger
\ No newline at end of file
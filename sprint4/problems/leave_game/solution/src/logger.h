@@ -8,6 +8,7 @@
 #include <boost/date_time.hpp>
 #include <boost/log/utility/manipulators/add_value.hpp>
 #include <boost/json.hpp>
+#include "async_logger.h"
 #include <unordered_map>
 #include <chrono>
 
@@ -19,13 +20,13 @@
 #define LOG_SERVER_EXIT(code, ...) \
         logger::Log({{"code"s, code} __VA_OPT__(, {"exception"s, __VA_ARGS__})}, logger::LOG_MESSAGES::SERVER_EXITED); 
 
-/* Получение запроса */
+/* Получение запроса (асинхронно) */
 #define LOG_REQUEST_RECEIVED(ip, URL, method) \
-    logger::Log({{"ip"s, ip}, {"URL"s, URL}, {"method", method}}, logger::LOG_MESSAGES::REQUEST_RECEIVED);
+    logger::LogRequestReceived(ip, URL, method);
 
-/* Формирование ответа */
+/* Формирование ответа (асинхронно) */
 #define LOG_RESPONSE_SENT(ip, response_time, code, content_type) \
-    logger::Log({{"ip"s, ip}, {"response_time"s, response_time}, {"code"s, code}, {"content_type", content_type}}, logger::LOG_MESSAGES::RESPONSE_SENT);
+    logger::LogResponseSent(ip, response_time, code, content_type);
 
 /* Возникновение ошибки */
 #define LOG_ERROR(code, text, where) \
@@ -46,22 +47,6 @@ enum class LOG_MESSAGES{
     ERROR
 };
 
-class Timer{
-public:
-    void Start(){
-        start_ = std::chrono::system_clock::now();
-    }
-
-    size_t End(){
-        auto dur = std::chrono::duration_cast<std::chrono::milliseconds>(
-            std::chrono::system_clock::now() - start_).count();
-        start_.min();
-        return dur;
-    }
-private:
-    std::chrono::system_clock::time_point start_ = std::chrono::system_clock::now();
-};
-
 static const std::unordered_map<LOG_MESSAGES, std::string> STR_MESSAGES {
     {LOG_MESSAGES::SERVER_STARTED, "Server has started..."},
     {LOG_MESSAGES::SERVER_EXITED, "server exited"},
@@ -80,6 +65,20 @@ void ConsoleConfig();
 
 void Log(const json::value& data, LOG_MESSAGES message);
 
+/*
+    Записи о запросах и ответах не проходят через ядро Boost.Log на потоке ввода-вывода:
+    они копируются в буфер потока и форматируются фоновым потоком AsyncLogger
+*/
+void LogRequestReceived(std::string_view ip, std::string_view url, std::string_view method);
+
+void LogResponseSent(std::string_view ip, size_t response_time, int code, std::string_view content_type);
+
+/* Записывать каждый rate-й запрос и ответ на него */
+void SetRequestLogSampling(unsigned rate);
+
+/* Решение, записывать ли очередной запрос и ответ на него */
+bool ShouldLogRequest();
+
 }; // namespace logger
 
 /* Настройка для вывода в консоль */
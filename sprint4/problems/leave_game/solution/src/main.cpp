@@ -54,25 +54,52 @@ int main(int argc, const char* argv[]) {
         auto db_manager = std::make_unique<db_connection::DatabaseManager>(NUM_THREADS, DB_URL);
 
         const cmd_parser::Args& received_args = args.value();
+        logger::SetRequestLogSampling(received_args.log_sample_rate);
+        compression::Configure({received_args.compression, received_args.compression_level, received_args.compression_min_size});
+        tracing::GetTraceRecorder().SetSlowThreshold(std::chrono::milliseconds(received_args.slow_request_threshold));
+        metrics::GetRegistry().AddCounterCallback("game_server_log_records_dropped_total"sv,
+            "Request log records dropped because the logger ring buffer was full"sv, []{
+                return static_cast<uint64_t>(logger::AsyncLogger::Instance().GetDroppedCount());
+            });
         // 1. Загружаем карту из файла и построить модель игры
         model::Game game = json_loader::LoadGame(received_args.config_file);
 
-        // 2. Инициализируем io_context
-        net::io_context ioc(NUM_THREADS);
+        // 2. Инициализируем io_context.
+        //    В режиме шардов соединения обслуживают отдельные io_context на каждом ядре,
+        //    а основной io_context выполняет только сигналы и служебный порт
+        const unsigned io_shards = received_args.io_shards;
+        const unsigned main_threads = io_shards > 0 ? 1u : NUM_THREADS;
+        net::io_context ioc(main_threads);
+        std::optional<http_server::IoShards> shards;
+        if (io_shards > 0) {
+            shards.emplace(io_shards);
+        }
+
+        // 2.1. Игровая модель принадлежит отдельному потоку симуляции.
+        //      Такты, вход в игру, действия и чтение состояния выполняются в его strand,
+        //      а сетевые потоки только ставят в него команды и получают ответы обратно.
+        //      Долгий такт не занимает сетевые потоки, а наплыв запросов - поток симуляции
+        net::io_context simulation_ioc(1);
+        auto simulation_work = net::make_work_guard(simulation_ioc);
 
         // 3. Добавляем асинхронный обработчик сигналов SIGINT и SIGTERM
         net::signal_set signals(ioc, SIGINT, SIGTERM);
-        signals.async_wait([&ioc](const sys::error_code& ec, [[maybe_unused]] int signal_number) {
+        signals.async_wait([&ioc, &shards, &simulation_ioc](const sys::error_code& ec, [[maybe_unused]] int signal_number) {
             if (!ec) {
                 ioc.stop();
+                simulation_ioc.stop();
+                if (shards) {
+                    shards->Stop();
+                }
                 std::cout << std::endl;
             }
         });   
 
         // 4. Создаём обработчик HTTP-запросов и связываем его с моделью игры. 
         //    А также устанавливаем слушаетеля, который сохраняет (сериализует) состояние
-        //    игры синхронно ходу игровым часам.
-        std::shared_ptr<request_handler::RequestHandler> handler = std::make_shared<request_handler::RequestHandler>(game, received_args, net::make_strand(ioc), std::move(db_manager));
+        //    игры синхронно ходу игровым часам. Запись в файл идет в фоновом потоке.
+        std::shared_ptr<request_handler::RequestHandler> handler = std::make_shared<request_handler::RequestHandler>(game, received_args, 
+            net::make_strand(simulation_ioc), ioc.get_executor(), std::move(db_manager));
 
         // 5. Если был указан файл с сохранением игрового состояния, 
         //    то нужно попытаться восстанавливать его.
@@ -82,18 +109,43 @@ int main(int argc, const char* argv[]) {
         // 6. Запустить обработчик HTTP-запросов, делегируя их обработчику запросов
         const auto address = net::ip::make_address("0.0.0.0");
         constexpr net::ip::port_type port = 8080;
-        http_server::ServeHttp(ioc, {address, port}, [&handler](auto&& req, auto&& send) {
-            (*handler)(std::forward<decltype(req)>(req), std::forward<decltype(send)>(send));
-        });
+        auto api_handler = [&handler](auto&& req, auto&& send, tracing::RequestTrace& trace) {
+            (*handler)(std::forward<decltype(req)>(req), std::forward<decltype(send)>(send), trace);
+        };
+        http_server::ListenerOptions listener_options;
+        listener_options.coroutine_sessions = received_args.coroutine_sessions;
+        listener_options.max_connections = received_args.max_connections;
+        listener_options.session.idle_timeout = std::chrono::seconds(received_args.idle_timeout);
+        listener_options.session.release_idle_buffers = received_args.release_idle_buffers;
+        if (shards) {
+            http_server::ServeHttpSharded(*shards, {address, port}, api_handler, listener_options);
+        } else {
+            http_server::ServeHttp(ioc, {address, port}, api_handler, listener_options);
+        }
         
 
+        // 6.1. Метрики отдаются на отдельном служебном порту, недоступном игровым клиентам
+        if(received_args.metrics_port.has_value()){
+            http_server::ServeHttp(ioc, {address, *received_args.metrics_port}, request_handler::MetricsHandler{});
+        }
+
         // Эта надпись сообщает тестам о том, что сервер запущен и готов обрабатывать запросы
         LOG_SERVER_START(port, address.to_string());
 
         // 7. Запускаем обработку асинхронных операций
-        RunWorkers(std::max(1u, NUM_THREADS), [&ioc] {
+        std::jthread simulation_thread([&simulation_ioc] {
+            simulation_ioc.run();
+        });
+        if (shards) {
+            shards->Start();
+        }
+        RunWorkers(main_threads, [&ioc] {
             ioc.run();
         });
+        if (shards) {
+            shards->Join();
+        }
+        simulation_thread.join();
 
         // 8. Сохраняем игровое состояние при выходе
         handler->SaveState();
@@ -0,0 +1,381 @@
+#include "metrics.h"
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <stdexcept>
+
+namespace metrics {
+
+using namespace std::literals;
+
+namespace detail{
+
+size_t GetThreadShard(){
+    static std::atomic<size_t> next_shard{0};
+    thread_local const size_t shard = next_shard.fetch_add(1, std::memory_order_relaxed) % SHARDS_COUNT;
+    return shard;
+}
+
+void AppendNumber(std::string& out, uint64_t value){
+    char buf[24];
+    out.append(buf, std::to_chars(buf, buf + sizeof(buf), value).ptr);
+}
+
+void AppendNumber(std::string& out, int64_t value){
+    char buf[24];
+    out.append(buf, std::to_chars(buf, buf + sizeof(buf), value).ptr);
+}
+
+/* Наносекунды в секунды в кратчайшей записи */
+void AppendSeconds(std::string& out, uint64_t value_ns){
+    char buf[32];
+    out.append(buf, std::to_chars(buf, buf + sizeof(buf), static_cast<double>(value_ns) / 1e9).ptr);
+}
+
+/* Имя метрики с метками, к которым при необходимости добавляется еще одна метка */
+void AppendSeriesName(std::string& out, std::string_view name, std::string_view labels, std::string_view extra_label = {}){
+    out.append(name);
+    if(labels.empty() && extra_label.empty()){
+        return;
+    }
+    out.push_back('{');
+    out.append(labels);
+    if(!labels.empty() && !extra_label.empty()){
+        out.push_back(',');
+    }
+    out.append(extra_label);
+    out.push_back('}');
+}
+
+} // namespace detail
+
+/* ------------------------ Counter ----------------------------------- */
+
+uint64_t Counter::Get() const{
+    uint64_t result = 0;
+    for(const auto& shard : shards_){
+        result += shard.value.load(std::memory_order_relaxed);
+    }
+    return result;
+}
+
+/* ------------------------ Histogram ----------------------------------- */
+
+size_t Histogram::GetBucketIndex(uint64_t value_ns){
+    value_ns = std::min(value_ns, (uint64_t{1} << MAX_BIT) - 1);
+    if(value_ns < SUB_BUCKETS){
+        return value_ns;
+    }
+    const unsigned msb = std::bit_width(value_ns) - 1;
+    const unsigned shift = msb - SUB_BUCKET_BITS;
+    return (shift + 1) * SUB_BUCKETS + ((value_ns >> shift) & (SUB_BUCKETS - 1));
+}
+
+uint64_t Histogram::GetBucketUpperBound(size_t index){
+    if(index < SUB_BUCKETS){
+        return index + 1;
+    }
+    const unsigned shift = index / SUB_BUCKETS - 1;
+    const uint64_t lower = (SUB_BUCKETS + index % SUB_BUCKETS) << shift;
+    return lower + (uint64_t{1} << shift);
+}
+
+void Histogram::Observe(uint64_t value_ns){
+    buckets_[GetBucketIndex(value_ns)].fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(value_ns, std::memory_order_relaxed);
+}
+
+uint64_t Histogram::GetCount() const{
+    uint64_t result = 0;
+    for(const auto& bucket : buckets_){
+        result += bucket.load(std::memory_order_relaxed);
+    }
+    return result;
+}
+
+std::array<uint64_t, Histogram::BUCKETS_COUNT> Histogram::GetBuckets() const{
+    std::array<uint64_t, BUCKETS_COUNT> result;
+    for(size_t i = 0; i < BUCKETS_COUNT; ++i){
+        result[i] = buckets_[i].load(std::memory_order_relaxed);
+    }
+    return result;
+}
+
+uint64_t Histogram::GetPercentile(double q) const{
+    auto buckets = GetBuckets();
+    uint64_t total = 0;
+    for(uint64_t count : buckets){
+        total += count;
+    }
+    if(total == 0){
+        return 0;
+    }
+
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(q * total + 0.5));
+    uint64_t seen = 0;
+    for(size_t i = 0; i < BUCKETS_COUNT; ++i){
+        seen += buckets[i];
+        if(seen >= rank){
+            return GetBucketUpperBound(i);
+        }
+    }
+    return GetBucketUpperBound(BUCKETS_COUNT - 1);
+}
+
+/* ------------------------ Registry ----------------------------------- */
+
+Registry::Family& Registry::GetFamily(std::string_view name, std::string_view help, Type type){
+    auto it = std::find_if(families_.begin(), families_.end(), [name](const Family& family){
+        return family.name == name;
+    });
+    if(it != families_.end()){
+        if(it->type != type){
+            throw std::logic_error("Metric "s + std::string(name) + " is registered with another type"s);
+        }
+        return *it;
+    }
+    return families_.emplace_back(Family{std::string(name), std::string(help), type, {}});
+}
+
+Counter& Registry::AddCounter(std::string_view name, std::string_view help, std::string labels){
+    std::lock_guard lock{mutex_};
+    auto counter = std::make_unique<Counter>();
+    Counter& result = *counter;
+    GetFamily(name, help, Type::COUNTER).series.emplace_back(Series{std::move(labels), std::move(counter)});
+    return result;
+}
+
+Gauge& Registry::AddGauge(std::string_view name, std::string_view help, std::string labels){
+    std::lock_guard lock{mutex_};
+    auto gauge = std::make_unique<Gauge>();
+    Gauge& result = *gauge;
+    GetFamily(name, help, Type::GAUGE).series.emplace_back(Series{std::move(labels), std::move(gauge)});
+    return result;
+}
+
+void Registry::AddGaugeCallback(std::string_view name, std::string_view help, GaugeCallback callback, std::string labels){
+    std::lock_guard lock{mutex_};
+    GetFamily(name, help, Type::GAUGE).series.emplace_back(Series{std::move(labels), std::move(callback)});
+}
+
+void Registry::AddCounterCallback(std::string_view name, std::string_view help, CounterCallback callback, std::string labels){
+    std::lock_guard lock{mutex_};
+    GetFamily(name, help, Type::COUNTER).series.emplace_back(Series{std::move(labels), std::move(callback)});
+}
+
+Histogram& Registry::AddHistogram(std::string_view name, std::string_view help, std::string labels){
+    std::lock_guard lock{mutex_};
+    auto histogram = std::make_unique<Histogram>();
+    Histogram& result = *histogram;
+    GetFamily(name, help, Type::HISTOGRAM).series.emplace_back(Series{std::move(labels), std::move(histogram)});
+    return result;
+}
+
+std::string Registry::Serialize() const{
+    /* Границы корзин, выводимые в Prometheus: конец каждой октавы начиная с ~1 мкс */
+    static constexpr size_t FIRST_EXPORTED_BUCKET = 8 * Histogram::SUB_BUCKETS - 1;
+
+    std::lock_guard lock{mutex_};
+    std::string out;
+    for(const Family& family : families_){
+        out.append("# HELP "sv).append(family.name).append(" "sv).append(family.help).append("\n"sv);
+        out.append("# TYPE "sv).append(family.name);
+        switch(family.type){
+            case Type::COUNTER:   out.append(" counter\n"sv); break;
+            case Type::GAUGE:     out.append(" gauge\n"sv); break;
+            case Type::HISTOGRAM: out.append(" histogram\n"sv); break;
+        }
+
+        for(const Series& series : family.series){
+            if(auto counter = std::get_if<std::unique_ptr<Counter>>(&series.value)){
+                detail::AppendSeriesName(out, family.name, series.labels);
+                out.push_back(' ');
+                detail::AppendNumber(out, (*counter)->Get());
+                out.push_back('\n');
+            } else if(auto gauge = std::get_if<std::unique_ptr<Gauge>>(&series.value)){
+                detail::AppendSeriesName(out, family.name, series.labels);
+                out.push_back(' ');
+                detail::AppendNumber(out, (*gauge)->Get());
+                out.push_back('\n');
+            } else if(auto callback = std::get_if<GaugeCallback>(&series.value)){
+                detail::AppendSeriesName(out, family.name, series.labels);
+                out.push_back(' ');
+                detail::AppendNumber(out, (*callback)());
+                out.push_back('\n');
+            } else if(auto callback = std::get_if<CounterCallback>(&series.value)){
+                detail::AppendSeriesName(out, family.name, series.labels);
+                out.push_back(' ');
+                detail::AppendNumber(out, (*callback)());
+                out.push_back('\n');
+            } else if(auto histogram = std::get_if<std::unique_ptr<Histogram>>(&series.value)){
+                const auto buckets = (*histogram)->GetBuckets();
+                const std::string bucket_name = family.name + "_bucket"s;
+                uint64_t cumulative = 0;
+                for(size_t i = 0; i < Histogram::BUCKETS_COUNT; ++i){
+                    cumulative += buckets[i];
+                    if(i < FIRST_EXPORTED_BUCKET || i % Histogram::SUB_BUCKETS != Histogram::SUB_BUCKETS - 1){
+                        continue;
+                    }
+                    std::string le = "le=\""s;
+                    detail::AppendSeconds(le, Histogram::GetBucketUpperBound(i));
+                    le.push_back('"');
+                    detail::AppendSeriesName(out, bucket_name, series.labels, le);
+                    out.push_back(' ');
+                    detail::AppendNumber(out, cumulative);
+                    out.push_back('\n');
+                }
+                detail::AppendSeriesName(out, bucket_name, series.labels, "le=\"+Inf\""sv);
+                out.push_back(' ');
+                detail::AppendNumber(out, cumulative);
+                out.push_back('\n');
+
+                detail::AppendSeriesName(out, family.name + "_sum"s, series.labels);
+                out.push_back(' ');
+                detail::AppendSeconds(out, (*histogram)->GetSum());
+                out.push_back('\n');
+
+                detail::AppendSeriesName(out, family.name + "_count"s, series.labels);
+                out.push_back(' ');
+                detail::AppendNumber(out, cumulative);
+                out.push_back('\n');
+            }
+        }
+    }
+    return out;
+}
+
+Registry& GetRegistry(){
+    static Registry registry;
+    return registry;
+}
+
+/* ------------------------ ServerMetrics ----------------------------------- */
+
+Route GetRoute(std::string_view target){
+    target = target.substr(0, target.find('?'));
+    if(!target.starts_with("/api/"sv)){
+        return target == "/metrics"sv ? Route::METRICS : Route::STATIC;
+    }
+    if(target == "/api/v1/maps"sv){
+        return Route::MAPS;
+    }
+    if(target.starts_with("/api/v1/maps/"sv)){
+        return Route::MAP;
+    }
+    if(target == "/api/v1/game/join"sv){
+        return Route::JOIN;
+    }
+    if(target == "/api/v1/game/players"sv){
+        return Route::PLAYERS;
+    }
+    if(target == "/api/v1/game/state"sv){
+        return Route::STATE;
+    }
+    if(target == "/api/v1/game/tick"sv){
+        return Route::TICK;
+    }
+    if(target == "/api/v1/game/player/action"sv){
+        return Route::ACTION;
+    }
+    if(target == "/api/v1/game/records"sv){
+        return Route::RECORDS;
+    }
+    return Route::OTHER_API;
+}
+
+std::string_view GetRouteName(Route route){
+    switch(route){
+        case Route::MAPS:      return "maps"sv;
+        case Route::MAP:       return "map"sv;
+        case Route::JOIN:      return "join"sv;
+        case Route::PLAYERS:   return "players"sv;
+        case Route::STATE:     return "state"sv;
+        case Route::TICK:      return "tick"sv;
+        case Route::ACTION:    return "action"sv;
+        case Route::RECORDS:   return "records"sv;
+        case Route::OTHER_API: return "other_api"sv;
+        case Route::STATIC:    return "static"sv;
+        case Route::METRICS:   return "metrics"sv;
+        default:               return "unknown"sv;
+    }
+}
+
+std::string_view GetTickPhaseName(TickPhase phase){
+    switch(phase){
+        case TickPhase::RETIRE:   return "retire"sv;
+        case TickPhase::SIMULATE: return "simulate"sv;
+        case TickPhase::SAVE:     return "save"sv;
+        case TickPhase::LOOT:     return "loot"sv;
+        default:                  return "unknown"sv;
+    }
+}
+
+std::string_view GetTaskClassName(TaskClass task_class){
+    switch(task_class){
+        case TaskClass::TICK:    return "tick"sv;
+        case TaskClass::LOOT:    return "loot"sv;
+        case TaskClass::REQUEST: return "request"sv;
+        default:                 return "unknown"sv;
+    }
+}
+
+ServerMetrics::ServerMetrics(Registry& registry)
+    : request_slices_yielded(registry.AddCounter("game_server_request_slices_yielded_total"sv,
+        "Times request handlers yielded api_strand to game ticks after exhausting the time budget"sv))
+    , tick_heap_allocations(registry.AddCounter("game_server_tick_heap_allocations_total"sv,
+        "Heap allocations of simulation scratch data not served by the tick arena"sv))
+    , tick_arena_bytes(registry.AddGauge("game_server_tick_arena_bytes"sv,
+        "Size of the per-tick simulation arena"sv))
+    , rejected_requests(registry.AddCounter("game_server_rejected_requests_total"sv,
+        "API requests rejected by admission control"sv))
+    , active_connections(registry.AddGauge("game_server_active_connections"sv,
+        "Open HTTP connections"sv))
+    , idle_connections(registry.AddGauge("game_server_idle_connections"sv,
+        "Keep-alive connections waiting for a request without read buffer"sv))
+    , rejected_connections(registry.AddCounter("game_server_rejected_connections_total"sv,
+        "Connections closed right after accept because of the connection limit"sv))
+    , game_sessions(registry.AddGauge("game_server_game_sessions"sv,
+        "Game sessions"sv))
+    , active_game_sessions(registry.AddGauge("game_server_active_game_sessions"sv,
+        "Game sessions with moving dogs, simulated on every tick"sv))
+    , retired_game_sessions(registry.AddCounter("game_server_retired_game_sessions_total"sv,
+        "Game sessions destroyed after staying without players for the retirement time"sv))
+    , snapshot_pause(registry.AddHistogram("game_server_snapshot_pause_seconds"sv,
+        "Time the game strand spends copying the state for a snapshot"sv))
+    , snapshot_duration(registry.AddHistogram("game_server_snapshot_duration_seconds"sv,
+        "Time the background thread spends serializing and writing a snapshot"sv))
+    , snapshots_superseded(registry.AddCounter("game_server_snapshots_superseded_total"sv,
+        "State copies dropped unwritten: replaced by a newer copy or left pending at shutdown"sv))
+    , players(registry.AddGauge("game_server_players"sv,
+        "Players in game"sv))
+    , dogs(registry.AddGauge("game_server_dogs"sv,
+        "Dogs in all game sessions"sv))
+    , loot(registry.AddGauge("game_server_loot"sv,
+        "Lost objects in all game sessions"sv))
+    , db_pool_wait(registry.AddHistogram("game_server_db_pool_wait_seconds"sv,
+        "Time spent waiting for a database connection"sv)){
+    for(size_t i = 0; i < static_cast<size_t>(Route::COUNT); ++i){
+        std::string labels = "route=\""s + std::string(GetRouteName(static_cast<Route>(i))) + "\""s;
+        requests[i] = &registry.AddCounter("game_server_requests_total"sv,
+            "HTTP requests by route"sv, labels);
+        request_latency[i] = &registry.AddHistogram("game_server_request_latency_seconds"sv,
+            "Time from request read to response written"sv, std::move(labels));
+    }
+    for(size_t i = 0; i < static_cast<size_t>(TickPhase::COUNT); ++i){
+        std::string labels = "phase=\""s + std::string(GetTickPhaseName(static_cast<TickPhase>(i))) + "\""s;
+        tick_duration[i] = &registry.AddHistogram("game_server_tick_duration_seconds"sv,
+            "Game tick duration by phase"sv, std::move(labels));
+    }
+    for(size_t i = 0; i < static_cast<size_t>(TaskClass::COUNT); ++i){
+        std::string labels = "class=\""s + std::string(GetTaskClassName(static_cast<TaskClass>(i))) + "\""s;
+        strand_queue_wait[i] = &registry.AddHistogram("game_server_strand_queue_wait_seconds"sv,
+            "Time handlers wait in api_strand queue by class"sv, std::move(labels));
+    }
+}
+
+ServerMetrics& GetServerMetrics(){
+    static ServerMetrics server_metrics(GetRegistry());
+    return server_metrics;
+}
+
+} // namespace metrics
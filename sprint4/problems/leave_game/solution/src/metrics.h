@@ -0,0 +1,252 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+namespace metrics {
+
+using Clock = std::chrono::steady_clock;
+
+/* Время в наносекундах между двумя отметками steady_clock */
+inline uint64_t ElapsedNs(Clock::time_point start, Clock::time_point end = Clock::now()){
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+}
+
+namespace detail{
+
+static constexpr size_t SHARDS_COUNT = 16;
+
+/* Индекс шарда, закрепленный за текущим потоком */
+size_t GetThreadShard();
+
+struct alignas(64) Shard{
+    std::atomic<uint64_t> value{0};
+};
+
+} // namespace detail
+
+/* ------------------------ Counter ----------------------------------- */
+
+/*
+    Монотонный счетчик.
+    Каждый поток увеличивает свой шард, поэтому запись не вызывает
+    конкуренции за одну кэш-линию. Шарды суммируются только при чтении.
+*/
+class Counter{
+public:
+    void Add(uint64_t value = 1){
+        shards_[detail::GetThreadShard()].value.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    uint64_t Get() const;
+private:
+    std::array<detail::Shard, detail::SHARDS_COUNT> shards_;
+};
+
+/* ------------------------ Gauge ----------------------------------- */
+
+class Gauge{
+public:
+    void Set(int64_t value){
+        value_.store(value, std::memory_order_relaxed);
+    }
+
+    void Add(int64_t value){
+        value_.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    int64_t Get() const{
+        return value_.load(std::memory_order_relaxed);
+    }
+private:
+    std::atomic<int64_t> value_{0};
+};
+
+/* ------------------------ Histogram ----------------------------------- */
+
+/*
+    Гистограмма в стиле HDR: логарифмически-линейные корзины.
+    Каждый интервал [2^k, 2^(k+1)) наносекунд делится на 8 равных корзин,
+    что дает относительную погрешность не хуже 12.5% во всем диапазоне
+    от 1 нс до ~73 минут. Запись - одна атомарная операция без блокировок.
+*/
+class Histogram{
+public:
+    static constexpr unsigned SUB_BUCKET_BITS = 3;
+    static constexpr unsigned SUB_BUCKETS = 1u << SUB_BUCKET_BITS;
+    static constexpr unsigned MAX_BIT = 42;
+    static constexpr size_t BUCKETS_COUNT = (MAX_BIT - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    void Observe(uint64_t value_ns);
+
+    uint64_t GetCount() const;
+
+    uint64_t GetSum() const{
+        return sum_.load(std::memory_order_relaxed);
+    }
+
+    /* Оценка квантиля q (0..1) по верхней границе корзины, в наносекундах */
+    uint64_t GetPercentile(double q) const;
+
+    std::array<uint64_t, BUCKETS_COUNT> GetBuckets() const;
+
+    static size_t GetBucketIndex(uint64_t value_ns);
+
+    /* Верхняя (не включаемая) граница корзины в наносекундах */
+    static uint64_t GetBucketUpperBound(size_t index);
+private:
+    std::array<std::atomic<uint64_t>, BUCKETS_COUNT> buckets_{};
+    std::atomic<uint64_t> sum_{0};
+};
+
+/* ------------------------ Registry ----------------------------------- */
+
+/*
+    Реестр метрик процесса.
+    Регистрация выполняется при старте, вызывающий хранит ссылку на метрику
+    и обновляет ее без обращения к реестру.
+    Serialize формирует текстовый формат Prometheus.
+*/
+class Registry{
+public:
+    using GaugeCallback = std::function<int64_t()>;
+    using CounterCallback = std::function<uint64_t()>;
+
+    Counter& AddCounter(std::string_view name, std::string_view help, std::string labels = {});
+
+    Gauge& AddGauge(std::string_view name, std::string_view help, std::string labels = {});
+
+    /* Значение вычисляется при каждом чтении метрик */
+    void AddGaugeCallback(std::string_view name, std::string_view help, GaugeCallback callback, std::string labels = {});
+
+    /* Счетчик, который ведется вне реестра: значение только растет и читается при каждом чтении метрик */
+    void AddCounterCallback(std::string_view name, std::string_view help, CounterCallback callback, std::string labels = {});
+
+    /* Гистограмма времени, выводится в секундах */
+    Histogram& AddHistogram(std::string_view name, std::string_view help, std::string labels = {});
+
+    std::string Serialize() const;
+private:
+    enum class Type{
+        COUNTER,
+        GAUGE,
+        HISTOGRAM
+    };
+
+    struct Series{
+        std::string labels;
+        std::variant<std::unique_ptr<Counter>, std::unique_ptr<Gauge>, GaugeCallback, CounterCallback, std::unique_ptr<Histogram>> value;
+    };
+
+    struct Family{
+        std::string name;
+        std::string help;
+        Type type;
+        std::deque<Series> series;
+    };
+
+    Family& GetFamily(std::string_view name, std::string_view help, Type type);
+
+    mutable std::mutex mutex_;
+    std::deque<Family> families_;
+};
+
+Registry& GetRegistry();
+
+/* ------------------------ ServerMetrics ----------------------------------- */
+
+enum class Route{
+    MAPS,
+    MAP,
+    JOIN,
+    PLAYERS,
+    STATE,
+    TICK,
+    ACTION,
+    RECORDS,
+    OTHER_API,
+    STATIC,
+    METRICS,
+    COUNT
+};
+
+Route GetRoute(std::string_view target);
+
+std::string_view GetRouteName(Route route);
+
+/* Фазы обработки игрового тика */
+enum class TickPhase{
+    RETIRE,
+    SIMULATE,
+    SAVE,
+    LOOT,
+    COUNT
+};
+
+std::string_view GetTickPhaseName(TickPhase phase);
+
+/* Классы обработчиков api_strand в порядке убывания приоритета */
+enum class TaskClass{
+    TICK,
+    LOOT,
+    REQUEST,
+    COUNT
+};
+
+std::string_view GetTaskClassName(TaskClass task_class);
+
+/* Метрики игрового сервера, зарегистрированные в GetRegistry() */
+struct ServerMetrics{
+    ServerMetrics(Registry& registry);
+
+    Histogram& GetRequestLatency(Route route){
+        return *request_latency[static_cast<size_t>(route)];
+    }
+
+    Counter& GetRequests(Route route){
+        return *requests[static_cast<size_t>(route)];
+    }
+
+    Histogram& GetTickDuration(TickPhase phase){
+        return *tick_duration[static_cast<size_t>(phase)];
+    }
+
+    Histogram& GetStrandQueueWait(TaskClass task_class){
+        return *strand_queue_wait[static_cast<size_t>(task_class)];
+    }
+
+    std::array<Histogram*, static_cast<size_t>(Route::COUNT)> request_latency;
+    std::array<Counter*, static_cast<size_t>(Route::COUNT)> requests;
+    std::array<Histogram*, static_cast<size_t>(TickPhase::COUNT)> tick_duration;
+    std::array<Histogram*, static_cast<size_t>(TaskClass::COUNT)> strand_queue_wait;
+    Counter& request_slices_yielded;
+    Counter& tick_heap_allocations;
+    Gauge& tick_arena_bytes;
+    Counter& rejected_requests;
+    Gauge& active_connections;
+    Gauge& idle_connections;
+    Counter& rejected_connections;
+    Gauge& game_sessions;
+    Gauge& active_game_sessions;
+    Counter& retired_game_sessions;
+    Histogram& snapshot_pause;
+    Histogram& snapshot_duration;
+    Counter& snapshots_superseded;
+    Gauge& players;
+    Gauge& dogs;
+    Gauge& loot;
+    Histogram& db_pool_wait;
+};
+
+ServerMetrics& GetServerMetrics();
+
+} // namespace metrics
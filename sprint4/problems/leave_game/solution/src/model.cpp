@@ -1,5 +1,6 @@
 #include "model.h"
 
+#include <cmath>
 #include <stdexcept>
 #include <set>
 
@@ -10,8 +11,7 @@ namespace detail{
 
 using namespace collision_detector;
 /*
-    Класс, предоставляющий всех собак и потерянных объектов
-    в сессии для обработки коллизий
+    Ширины объектов для обработки коллизий
 
     Предметы — ширина ноль,
     Игроки — ширина 0,6,
@@ -22,71 +22,51 @@ static const double LOOT_WIDTH = 0;
 static const double DOG_WIDTH = 0.6;
 static const double OFFICE_WIDTH = 0.5;
 
-class ObjectsAndDogsProvider : public ItemGathererProvider{
-public:
-    using Objects = std::vector<Item>;
-    using Dogs = std::vector<Gatherer>;
-
-    ObjectsAndDogsProvider(Objects objects, Dogs dogs)
-    : objects_(std::move(objects)), dogs_(std::move(dogs)){}
-
-    size_t ItemsCount() const override{
-        return objects_.size();
-    }
-
-    Item GetItem(size_t idx) const override{
-        return objects_[idx];
-    }
-
-    size_t GatherersCount() const override{
-        return dogs_.size();
-    }
-
-    Gatherer GetGatherer(size_t idx) const override{
-        return dogs_[idx];
-    }
-private:
-    Objects objects_;
-    Dogs dogs_;
-};
-
-ObjectsAndDogsProvider::Objects MakeLoot(const std::list<Loot>& loots){
-    ObjectsAndDogsProvider::Objects result;
-
-    for(const Loot& loot : loots){
-        result.emplace_back(loot.pos, LOOT_WIDTH);
-    }
-
-    return result;
-}
-
-ObjectsAndDogsProvider::Objects MakeOffices(const std::deque<Office>& offices){
-    ObjectsAndDogsProvider::Objects result;
-
-    for(const Office& office : offices){
-        Point2D pos = {
-            static_cast<double>(office.GetPosition().x), 
-            static_cast<double>(office.GetPosition().y)
-        };
-        result.emplace_back(pos, OFFICE_WIDTH);
+using Gatherers = std::pmr::vector<Gatherer>;
+using GatheringEvents = std::pmr::vector<GatheringEvent>;
+
+/* События подбора предметов: item_id - номер предмета в списке сессии */
+GatheringEvents FindLootEvents(const std::list<Loot>& loots, const Gatherers& dogs, std::pmr::memory_resource* memory){
+    GatheringEvents events(memory);
+    for(size_t gatherer_id = 0; gatherer_id < dogs.size(); ++gatherer_id){
+        const Gatherer& gatherer = dogs[gatherer_id];
+        size_t item_id = 0;
+        for(const Loot& loot : loots){
+            CollectionResult res = TryCollectPoint(gatherer.start_pos, gatherer.end_pos, loot.pos);
+            if(res.IsCollected(gatherer.width + LOOT_WIDTH)){
+                events.emplace_back(item_id, gatherer_id, res.sq_distance, res.proj_ratio);
+            }
+            ++item_id;
+        }
     }
-
-    return result;
+    return events;
 }
 
-ObjectsAndDogsProvider::Dogs MakeDogs(const std::list<Dog>& dogs, double delta){
-    ObjectsAndDogsProvider::Dogs result;
-
-    for(const Dog& dog : dogs){
-        PairDouble speed = *(dog.GetSpeed());
-
-        Point2D start_pos = *(dog.GetPosition());
-        Point2D end_pos = {start_pos.x + speed.x * delta, start_pos.y + speed.y * delta};
-
-        result.emplace_back(start_pos, end_pos, DOG_WIDTH);
+/*
+    События доставки в офисы.
+    Проверяются только офисы из индекса карты рядом с отрезком пути собаки
+*/
+GatheringEvents FindDeliveryEvents(const Map& map, const Gatherers& dogs, std::pmr::memory_resource* memory){
+    GatheringEvents events(memory);
+    const Map::Offices& offices = map.GetOffices();
+    for(size_t gatherer_id = 0; gatherer_id < dogs.size(); ++gatherer_id){
+        const Gatherer& gatherer = dogs[gatherer_id];
+        const double reach = gatherer.width + OFFICE_WIDTH;
+        const PairDouble min{std::min(gatherer.start_pos.x, gatherer.end_pos.x) - reach, 
+                             std::min(gatherer.start_pos.y, gatherer.end_pos.y) - reach};
+        const PairDouble max{std::max(gatherer.start_pos.x, gatherer.end_pos.x) + reach, 
+                             std::max(gatherer.start_pos.y, gatherer.end_pos.y) + reach};
+
+        map.GetOfficeIndex().ForEachInRect(min, max, [&](size_t office_id){
+            const Point pos = offices[office_id].GetPosition();
+            CollectionResult res = TryCollectPoint(gatherer.start_pos, gatherer.end_pos, 
+                                                   {static_cast<double>(pos.x), static_cast<double>(pos.y)});
+            if(res.IsCollected(reach)){
+                events.emplace_back(office_id, gatherer_id, res.sq_distance, res.proj_ratio);
+            }
+        });
     }
-
-    return result;
+    return events;
 }
 
 enum class GatheringEventType{
@@ -98,8 +78,9 @@ enum class GatheringEventType{
     Смешивает события столкновений в хронологическом порядке
 */
 using Event = std::pair<GatheringEvent, GatheringEventType>;
-std::vector<Event> MixEvents(std::vector<GatheringEvent> collectings, std::vector<GatheringEvent> deliverings){
-    std::vector<Event> result;
+std::pmr::vector<Event> MixEvents(const GatheringEvents& collectings, const GatheringEvents& deliverings, 
+                                  std::pmr::memory_resource* memory){
+    std::pmr::vector<Event> result(memory);
     size_t collectings_count = collectings.size();
     size_t deliverings_count = deliverings.size();
     
@@ -165,12 +146,10 @@ void Map::AddRoad(const Road& road) {
     }
 }
 
-std::vector<const Road*> Map::FindRoadsByCoords(const Dog::Position& pos) const{
-    std::vector<const Road*> result;
-    FindInVerticals(pos, result);
-    FindInHorizontals(pos, result);
-
-    return result;
+void Map::FindRoadsByCoords(const Dog::Position& pos, RoadsBuffer& roads) const{
+    roads.clear();
+    FindInVerticals(pos, roads);
+    FindInHorizontals(pos, roads);
 }
 
 void Map::AddBuilding(const Building& building) {
@@ -191,6 +170,7 @@ void Map::AddOffice(Office office) {
         offices_.pop_back();
         throw;
     }
+    office_index_.Insert({static_cast<double>(o.GetPosition().x), static_cast<double>(o.GetPosition().y)}, index);
 }
 
 void Map::AddLootType(LootType loot_type){
@@ -213,6 +193,14 @@ unsigned Map::GetBagCapacity() const{
     return bag_capacity_;
 }
 
+void Map::SetInterestRadius(double radius){
+    interest_radius_ = radius;
+}
+
+std::optional<double> Map::GetInterestRadius() const{
+    return interest_radius_;
+}
+
 PairDouble Map::GetFirstPos(const model::Map::Roads& roads){
     const Point& pos = roads.begin()->GetStart();
     return {static_cast<double>(pos.x), static_cast<double>(pos.y)};
@@ -234,48 +222,24 @@ PairDouble Map::GetRandomPos(const model::Map::Roads& roads){
     return {x,y};
 }
 
-void Map::FindInVerticals(const Dog::Position& pos, std::vector<const Road*>& roads) const{
-    const auto& v_roads = road_map_.at(Map::RoadTag::VERTICAL);
-    ConstRoadIt it_x = v_roads.lower_bound((*pos).x);          /* Ищем ближайшую дорогу по полученной координате */
-
-    if(it_x != v_roads.end()){                 
-        if(it_x != v_roads.begin()){                   /* Если ближайшая дорога не является первой, то нужно проверить предыдущую */
-            ConstRoadIt prev_it_x = std::prev(it_x, 1);
-            if(CheckBounds(prev_it_x, pos)){
-                roads.push_back(&prev_it_x->second);
-            }
-        }
-
-        if(CheckBounds(it_x, pos)){                     /* Проверяем ближайшую дорогу */
-            roads.push_back(&it_x->second);
-        }
-    } else {                                            /* Если дорога не найдена, то полученная координата дальше всех дорог*/
-        it_x = std::prev(v_roads.end(), 1);            /* Тогда проверяем последнюю дорогу */
-        if(CheckBounds(it_x, pos)){
-            roads.push_back(&it_x->second);
-        }
-    }
+void Map::FindInVerticals(const Dog::Position& pos, RoadsBuffer& roads) const{
+    FindInRoads(Map::RoadTag::VERTICAL, (*pos).x, pos, roads);
 }
 
-void Map::FindInHorizontals(const Dog::Position& pos, std::vector<const Road*>& roads) const{
-    const auto& h_roads = road_map_.at(Map::RoadTag::HORIZONTAl);
-    ConstRoadIt it_y = h_roads.lower_bound((*pos).y);          /* Ищем ближайшую дорогу по полученной координате */
-
-    if(it_y != h_roads.end()){                 
-        if(it_y != h_roads.begin()){                   /* Если ближайшая дорога не является первой, то нужно проверить предыдущую */
-            ConstRoadIt prev_it_y = std::prev(it_y, 1);
-            if(CheckBounds(prev_it_y, pos)){
-                roads.push_back(&prev_it_y->second);
-            }
-        }
+void Map::FindInHorizontals(const Dog::Position& pos, RoadsBuffer& roads) const{
+    FindInRoads(Map::RoadTag::HORIZONTAl, (*pos).y, pos, roads);
+}
 
-        if(CheckBounds(it_y, pos)){                     /* Проверяем ближайшую дорогу */
-            roads.push_back(&it_y->second);
-        }
-    } else {                                            /* Если дорога не найдена, то полученная координата дальше всех дорог*/
-        it_y = std::prev(h_roads.end(), 1);            /* Тогда проверяем последнюю дорогу */
-        if(CheckBounds(it_y, pos)){
-            roads.push_back(&it_y->second);
+void Map::FindInRoads(RoadTag tag, double coord, const Dog::Position& pos, RoadsBuffer& roads) const{
+    auto tag_roads = road_map_.find(tag);
+    if(tag_roads == road_map_.end()){
+        return;
+    }
+    /* Проверяем все дороги, до прямой которых не больше половины ширины дороги */
+    const auto end = tag_roads->second.upper_bound(coord + 0.4);
+    for(auto it = tag_roads->second.lower_bound(coord - 0.4); it != end; ++it){
+        if(CheckBounds(it, pos)){
+            roads.push_back(&it->second);
         }
     }
 }
@@ -294,13 +258,33 @@ bool Map::CheckBounds(ConstRoadIt it, const Dog::Position& pos) const{
 Dog* GameSession::AddDog(int id, const Dog::Name& name, 
                     const Dog::Position& pos, const Dog::Speed& vel, 
                     Direction dir){
-    dogs_.emplace_back(id, name, pos, vel, dir);
-    return &dogs_.back();
+    return TrackDog(dogs_.emplace(dogs_.end(), id, name, pos, vel, dir));
 }
 
 Dog* GameSession::AddCreatedDog(Dog new_dog){
-    dogs_.emplace_back(std::move(new_dog));
-    return &dogs_.back();
+    return TrackDog(dogs_.emplace(dogs_.end(), std::move(new_dog)));
+}
+
+Dog* GameSession::TrackDog(std::list<Dog>::iterator it){
+    Dog& dog = *it;
+    if(!dog_by_id_.emplace(dog.GetId(), it).second){
+        dogs_.erase(it);
+        throw std::logic_error("Dog with this id has already been added");
+    }
+
+    static const Dog::Speed zero_speed({0, 0});
+    if(dog.GetSpeed() != zero_speed){
+        ++moving_dogs_;
+    }
+    /* Сигнал вызывается до записи новой скорости, поэтому GetSpeed возвращает прежнюю */
+    dog.SetSlotSpeed([this, dog = &dog](Dog::Speed new_speed){
+        const bool was_moving = dog->GetSpeed() != zero_speed;
+        const bool is_moving = new_speed != zero_speed;
+        if(was_moving != is_moving){
+            is_moving ? ++moving_dogs_ : --moving_dogs_;
+        }
+    });
+    return &dog;
 }
 
 const Map* GameSession::GetMap() const {
@@ -337,59 +321,63 @@ const std::list<Loot>& GameSession::GetLootObjects() const{
     return loot_;
 }
 
-void GameSession::DeleteCollectedLoot(const std::set<size_t>& collected_items){
-    for(auto collect_id = collected_items.rbegin(); collect_id != collected_items.rend(); std::advance(collect_id, 1)){
-        auto it = std::next(loot_.begin(), *collect_id);
-        loot_.erase(it);
+void GameSession::DeleteCollectedLoot(const std::pmr::vector<bool>& is_collected){
+    size_t index = 0;
+    for(auto it = loot_.begin(); it != loot_.end(); ++index){
+        it = index < is_collected.size() && is_collected[index] ? loot_.erase(it) : std::next(it);
     }
 }
 
 void GameSession::DeleteDog(const Dog* erasing_dog){
-    auto it = std::find_if(dogs_.begin(), dogs_.end(), [erasing_dog](const Dog& dog){
-        return &dog == erasing_dog;
-    });
+    auto id_it = dog_by_id_.find(erasing_dog->GetId());
+    auto it = id_it->second;
+    dog_by_id_.erase(id_it);
 
+    if(it->GetSpeed() != Dog::Speed({0, 0})){
+        --moving_dogs_;
+    }
     dogs_.erase(it);
 }
 
 /* ------------------------ Game ----------------------------------- */
 
 void Game::AddMap(Map&& map) {
-    const size_t index = maps_.size();
+    const Map::Index index = maps_.size();
     if (auto [it, inserted] = map_id_to_index_.emplace(map.GetId(), index); !inserted) {
         throw std::invalid_argument("Map with id "s + *map.GetId() + " already exists"s);
     } else {
         try {
+            map.SetIndex(index);
+            sessions_by_map_.resize(index + 1);
             maps_.emplace_back(std::move(map));
         } catch (...) {
+            sessions_by_map_.resize(index);
             map_id_to_index_.erase(it);
             throw;
         }
     }
 }
 
-GameSession* Game::AddSession(const Map::Id& map_id){
-    if(const Map* map = FindMap(map_id); map != nullptr){
-        GameSession* session = &(map_id_to_sessions_[map_id].emplace_back(map));
-        return session;
+GameSession* Game::AddSession(const Map& map){
+    MapSessions& sessions = sessions_by_map_[map.GetIndex()];
+    if(!sessions.free_slots.empty()){
+        std::optional<GameSession>& slot = sessions.slots[sessions.free_slots.back()];
+        sessions.free_slots.pop_back();
+        return &slot.emplace(&map);
     }
-    return nullptr;
+    return &sessions.slots.emplace_back().emplace(&map);
 }
 
-GameSession* Game::SessionIsExists(const Map::Id& map_id){
-    if(const Map* map = FindMap(map_id); map != nullptr){
-        if(!map_id_to_sessions_[map_id].empty()){
-            GameSession* session = &(map_id_to_sessions_[map_id].back());
-            return session;
+GameSession* Game::SessionIsExists(const Map& map){
+    auto& slots = sessions_by_map_[map.GetIndex()].slots;
+    for(auto it = slots.rbegin(); it != slots.rend(); ++it){
+        if(*it){
+            return &**it;
         }
     }
     return nullptr;
 }
 
-const Game::SessionsByMapId& Game::GetAllSessions() const{
-    return map_id_to_sessions_;
-}
-
 void Game::SetLootGenerator(double period, double probability){
     loot_generator_.emplace(detail::FromDouble(period), probability);
 }
@@ -418,6 +406,14 @@ unsigned Game::GetDogRetirementTime() const{
     return dog_retirement_time_;
 }
 
+void Game::SetSessionRetirementTime(double session_retirement_time){
+    session_retirement_time_ = session_retirement_time;
+}
+
+double Game::GetSessionRetirementTime() const{
+    return session_retirement_time_;
+}
+
 const Game::Maps& Game::GetMaps() const noexcept {
     return maps_;
 }
@@ -434,122 +430,169 @@ detail::Milliseconds Game::GetLootGeneratePeriod() const{
 }
 
 void Game::GenerateLootInSessions(detail::Milliseconds delta){
-    for(auto& [map_id, sessions] : map_id_to_sessions_){
-        for(GameSession& session : sessions){
-            unsigned current_loot_count = session.GetLootObjects().size();
-            unsigned loot_count = (*loot_generator_).Generate(delta, current_loot_count, session.GetDogs().size());
-            session.UpdateLoot(loot_count);
-        }
-    }
+    ForEachSession([this, delta](GameSession& session){
+        unsigned current_loot_count = session.GetLootObjects().size();
+        unsigned loot_count = (*loot_generator_).Generate(delta, current_loot_count, session.GetDogs().size());
+        session.UpdateLoot(loot_count);
+    });
 }
 
 void Game::UpdateGameState(unsigned delta){
     double delta_in_seconds = static_cast<double>(delta) / 1000;
-    for(auto& [map_id, sessions] : map_id_to_sessions_){
-        for(GameSession& session : sessions){
-            UpdateDogsLoot(session, delta_in_seconds);
-            UpdateAllDogsPositions(session.GetDogs(), session.GetMap(), delta_in_seconds);
+    stopped_dogs_.clear();
+    tick_arena_.Reset();
+    ForEachSession([this, delta_in_seconds](GameSession& session){
+        if(session.HasMovingDogs()){
+            SimulateSession(session, delta_in_seconds, tick_arena_.GetResource());
         }
-    }
-}
-
-void Game::DisconnectDogFromSession(const GameSession* player_session, const Dog* erasing_dog){
-    Map::Id map_id = player_session->GetMap()->GetId();
-
-    std::deque<GameSession>& sessions = map_id_to_sessions_.at(map_id);
-    auto it = std::find_if(sessions.begin(), sessions.end(), [player_session](const GameSession& session){
-        return &session == player_session;
     });
-
-    GameSession& found_session = *it;
-    found_session.DeleteDog(erasing_dog);
 }
 
-void Game::UpdateAllDogsPositions(std::list<Dog>& dogs, const Map* map, double delta){
-    for(Dog& dog : dogs){
-        std::vector<const Road*> roads = map->FindRoadsByCoords(dog.GetPosition());
-        UpdateDogPos(dog, roads, delta);
+const Game::RetiredSessions& Game::RetireEmptySessions(unsigned delta){
+    const double delta_in_seconds = static_cast<double>(delta) / 1000;
+    retired_sessions_.clear();
+    for(MapSessions& sessions : sessions_by_map_){
+        for(size_t i = 0; i < sessions.slots.size(); ++i){
+            std::optional<GameSession>& slot = sessions.slots[i];
+            if(!slot || slot->UpdateEmptyTime(delta_in_seconds) < session_retirement_time_){
+                continue;
+            }
+            retired_sessions_.push_back(&*slot);
+            slot.reset();
+            sessions.free_slots.push_back(i);
+        }
+
+        /* Свободные слоты в конце больше не нужны, их память освобождается */
+        while(!sessions.slots.empty() && !sessions.slots.back()){
+            sessions.slots.pop_back();
+        }
+        std::erase_if(sessions.free_slots, [size = sessions.slots.size()](size_t i){
+            return i >= size;
+        });
     }
+    return retired_sessions_;
 }
 
-void Game::UpdateDogPos(Dog& dog, const std::vector<const Road*>& roads, double delta){
-    const auto [x, y] = *(dog.GetPosition());
-    const auto [vx, vy] = *(dog.GetSpeed());
-
-    const PairDouble getting_pos({x + vx * delta, y + vy * delta});
-    const PairDouble getting_speed({vx, vy});
-
-    PairDouble result_pos(getting_pos);
-    PairDouble result_speed(getting_speed);
-
-    std::set<PairDouble> collisions;
+void Game::DisconnectDogFromSession(GameSession& player_session, const Dog* erasing_dog){
+    player_session.DeleteDog(erasing_dog);
+}
 
+double Game::GetReachableDistance(const PairDouble& pos, const PairDouble& speed, const Map::RoadsBuffer& roads){
+    double result = 0;
     for(const Road* road : roads){
         Point start = road->GetStart();
         Point end = road->GetEnd();
-
         if(road->IsInvert()){
             std::swap(start, end);
         }
 
-        if(IsInsideRoad(getting_pos, start, end)){
-            dog.SetPosition(Dog::Position(getting_pos));
-            dog.SetSpeed(Dog::Speed(getting_speed));
-            return;
+        double distance = 0;
+        if(speed.x > 0){
+            distance = end.x + road_offset_ - pos.x;
+        } else if(speed.x < 0){
+            distance = pos.x - (start.x - road_offset_);
+        } else if(speed.y > 0){
+            distance = end.y + road_offset_ - pos.y;
+        } else if(speed.y < 0){
+            distance = pos.y - (start.y - road_offset_);
         }
+        result = std::max(result, distance);
+    }
+    return result;
+}
 
-        if(start.x - 0.4 >= getting_pos.x) {
-            result_pos.x = start.x - 0.4;
-        } else if(getting_pos.x >= end.x + 0.4){
-            result_pos.x = end.x + 0.4;
+void Game::MoveDog(Dog& dog, size_t dog_index, const Map* map, double delta, DogPaths& paths){
+    PairDouble pos = *(dog.GetPosition());
+    const PairDouble speed = *(dog.GetSpeed());
+    /* Собаки движутся только вдоль осей */
+    const double speed_abs = std::abs(speed.x) + std::abs(speed.y);
+    const PairDouble dir{speed.x > 0 ? 1. : speed.x < 0 ? -1. : 0., speed.y > 0 ? 1. : speed.y < 0 ? -1. : 0.};
+
+    /*
+        Событие движения одно - собака доходит до края дорог, на которых стоит.
+        В этой точке может начинаться продолжающая дорога, поэтому дороги ищутся заново.
+        Число итераций ограничено числом дорог на пути, а не длиной интервала
+    */
+    for(double time = 0; time < delta;){
+        const double remaining = delta - time;
+        map->FindRoadsByCoords(Dog::Position(pos), paths.roads);
+        const double reachable = GetReachableDistance(pos, speed, paths.roads);
+        const double wanted = speed_abs * remaining;
+        const double step = std::min(reachable, wanted);
+        const double step_time = step < wanted ? step / speed_abs : remaining;
+
+        if(step > 0){
+            const PairDouble end{pos.x + dir.x * step, pos.y + dir.y * step};
+            paths.gatherers.push_back({pos, end, detail::DOG_WIDTH});
+            paths.segments.push_back({dog_index, time, step_time});
+            pos = end;
         }
-
-        if(start.y - 0.4 >= getting_pos.y) {
-            result_pos.y = start.y - 0.4;
-        } else if(getting_pos.y >= end.y + 0.4){
-            result_pos.y = end.y + 0.4;
+        if(step >= wanted){
+            break;
         }
-
-        collisions.insert(result_pos);
-    }
-
-    if(collisions.size() != 0){
-        result_pos = *(std::prev(collisions.end(), 1));
-        result_speed = {0,0};
+        if(step <= 0){
+            /* Собака уперлась в край дороги и простоит до конца интервала */
+            stopped_dogs_.emplace_back(&dog, remaining);
+            dog.SetPosition(Dog::Position(pos));
+            dog.SetSpeed(Dog::Speed({0, 0}));
+            return;
+        }
+        time += step_time;
     }
-    
-    dog.SetPosition(Dog::Position(result_pos));
-    dog.SetSpeed(Dog::Speed(result_speed));
-}   
+    dog.SetPosition(Dog::Position(pos));
+}
 
-void Game::UpdateDogsLoot(GameSession& session, double delta) {
+void Game::SimulateSession(GameSession& session, double delta, std::pmr::memory_resource* memory) {
     using namespace collision_detector;
     std::list<Dog>& dogs = session.GetDogs();
     const std::list<Loot>& all_loots = session.GetLootObjects();
     unsigned max_bag_capacity = session.GetMap()->GetBagCapacity();
-    const std::deque<Office>& offices = session.GetMap()->GetOffices();
 
-    /* Провайдер для предоставления событий при подборе предметов*/
-    detail::ObjectsAndDogsProvider loots_provider(detail::MakeLoot(all_loots), detail::MakeDogs(dogs, delta));
+    /* Сначала строятся пути всех собак: движение не зависит от подобранных предметов */
+    DogPaths paths(memory);
+    std::pmr::vector<Dog*> dogs_by_index(memory);
+    for(Dog& dog : dogs){
+        if(dog.GetSpeed() == Dog::Speed({0, 0})){
+            continue;
+        }
+        MoveDog(dog, dogs_by_index.size(), session.GetMap(), delta, paths);
+        dogs_by_index.push_back(&dog);
+    }
+
+    /* Пути собак общие для подбора предметов и доставки в офисы */
+    detail::GatheringEvents loot_events = detail::FindLootEvents(all_loots, paths.gatherers, memory);
+    detail::GatheringEvents delivery_events = detail::FindDeliveryEvents(*session.GetMap(), paths.gatherers, memory);
 
-    /* Провайдер для предоставления событий при доставке в офис */
-    detail::ObjectsAndDogsProvider offices_provider(detail::MakeOffices(offices), detail::MakeDogs(dogs, delta));
-    auto events = detail::MixEvents(FindGatherEvents(loots_provider), FindGatherEvents(offices_provider));
-    std::set<size_t> collected_loot;
+    /* Время события на отрезке переводится во время от начала интервала */
+    auto to_interval_time = [&paths](detail::GatheringEvents& events){
+        for(GatheringEvent& event : events){
+            const DogPaths::Segment& segment = paths.segments[event.gatherer_id];
+            event.time = segment.start_time + event.time * segment.duration;
+            event.gatherer_id = segment.dog_index;
+        }
+    };
+    to_interval_time(loot_events);
+    to_interval_time(delivery_events);
+    auto events = detail::MixEvents(loot_events, delivery_events, memory);
+
+    std::pmr::vector<bool> is_collected(all_loots.size(), false, memory);
+    /* Список предметов не меняется до конца тика, поэтому итераторы находятся один раз */
+    std::pmr::vector<const Loot*> loot_by_index(memory);
+    loot_by_index.reserve(all_loots.size());
+    for(const Loot& loot : all_loots){
+        loot_by_index.push_back(&loot);
+    }
     for(const auto& [event, event_type] : events){
-        auto dog_it = std::next(dogs.begin(), event.gatherer_id);
-        Dog& dog = *dog_it;
+        Dog& dog = *dogs_by_index[event.gatherer_id];
         switch (event_type){
             case detail::GatheringEventType::DOG_COLLECT_ITEM:
                 // Собака подбирает предмет
                 // если её рюкзак не полон
                 if((*dog.GetBag()).size() < max_bag_capacity){
                     // если до этого этот предмет не подбирали
-                    if(!collected_loot.count(event.item_id)){
-                        auto loot_it = std::next(all_loots.begin(), event.item_id);
-                        const Loot& loot = *loot_it;
-                        dog.CollectItem(loot);
-                        collected_loot.insert(event.item_id);
+                    if(!is_collected[event.item_id]){
+                        dog.CollectItem(*loot_by_index[event.item_id]);
+                        is_collected[event.item_id] = true;
                     }
                 }
                 break;
@@ -563,17 +606,7 @@ void Game::UpdateDogsLoot(GameSession& session, double delta) {
     }
 
     /* Подобранные предметы должны пропасть с карты*/
-    session.DeleteCollectedLoot(collected_loot);
-}
-
-bool Game::IsInsideRoad(const PairDouble& getting_pos, const Point& start, const Point& end){
-    bool in_left_border = getting_pos.x >= start.x - road_offset_;
-    bool in_right_border = getting_pos.x <= end.x + road_offset_;
-    bool in_upper_border = getting_pos.y >= start.y - road_offset_;
-    bool in_lower_border = getting_pos.y <= end.y + road_offset_;
-
-    return in_left_border && in_right_border && in_upper_border && in_lower_border;
+    session.DeleteCollectedLoot(is_collected);
 }
 
-
 }  // namespace model
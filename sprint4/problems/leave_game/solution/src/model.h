@@ -9,12 +9,21 @@
 #include <list>
 #include <iostream>
 #include <optional>
+#include <memory_resource>
 #include <boost/signals2.hpp>
 
 #include "geom.h"
 #include "tagged.h"
 #include "loot_generator.h"
 #include "collision_detector.h"
+#include "spatial_index.h"
+#include "tick_arena.h"
+#include "inline_vector.h"
+
+/* Сколько предметов рюкзака хранится в самой собаке. Рюкзаки большей вместимости выделяют память в куче */
+#ifndef GAME_BAG_INLINE_CAPACITY
+#define GAME_BAG_INLINE_CAPACITY 3
+#endif
 
 namespace model {
 
@@ -43,6 +52,8 @@ struct Loot{
     unsigned type;
     unsigned value;
     PairDouble pos;
+
+    bool operator==(const Loot&) const = default;
 };
 
 class Road {
@@ -160,7 +171,8 @@ public:
     using Position = util::Tagged<PairDouble, Dog>;
     using Speed = util::Tagged<PairDouble, Dog>;
     using SpeedSignal = sig::signal<void(Speed new_speed)>;
-    using Bag = util::Tagged<std::deque<Loot>, Dog>;
+    static constexpr size_t BAG_INLINE_CAPACITY = GAME_BAG_INLINE_CAPACITY;
+    using Bag = util::Tagged<util::InlineVector<Loot, BAG_INLINE_CAPACITY>, Dog>;
 
     Dog(int id, Name name, Position pos, Speed speed, Direction dir) noexcept
         : id_(id), name_(name)
@@ -222,7 +234,7 @@ public:
         for(const Loot& loot : (*bag_)){
             score_ += loot.value;
         }
-        (*bag_).resize(0);
+        (*bag_).clear();
     }
 
     void SetBagCapacity(unsigned new_bag_capacity){
@@ -236,6 +248,10 @@ public:
     const Bag& GetBag() const{
         return bag_;
     }
+
+    void SetBag(Bag bag){
+        bag_ = std::move(bag);
+    }
     
     void SetScore(unsigned new_score){
         score_ = new_score;
@@ -259,14 +275,17 @@ private:
 class Map {
 public:
     using Id = util::Tagged<std::string, Map>;
+    /* Плотный номер карты в игре. Строковый Id нужен только на границе с JSON */
+    using Index = size_t;
     enum class RoadTag{
         VERTICAL,
         HORIZONTAl
     };
     using Roads = std::deque<Road>;
-    using RoadMap = std::map<RoadTag, std::map<double, const Road&>>;
-    using RoadIt = std::map<double, const Road&>::iterator;
-    using ConstRoadIt = std::map<double, const Road&>::const_iterator;
+    /* Несколько дорог могут лежать на одной прямой, поэтому координата не уникальна */
+    using RoadMap = std::map<RoadTag, std::multimap<double, const Road&>>;
+    using RoadIt = std::multimap<double, const Road&>::iterator;
+    using ConstRoadIt = std::multimap<double, const Road&>::const_iterator;
     using Buildings = std::deque<Building>;
     using Offices = std::deque<Office>;
     using LootTypes = std::deque<LootType>;
@@ -278,6 +297,15 @@ public:
 
     const Id& GetId() const noexcept;
 
+    Index GetIndex() const noexcept{
+        return index_;
+    }
+
+    /* Номер назначается игрой при добавлении карты */
+    void SetIndex(Index index) noexcept{
+        index_ = index;
+    }
+
     const std::string& GetName() const noexcept;
 
     const Buildings& GetBuildings() const noexcept;
@@ -285,6 +313,11 @@ public:
     const Roads& GetRoads() const noexcept;
 
     const Offices& GetOffices() const noexcept;
+
+    /* Индексы офисов в GetOffices(), разложенные по сетке. Офисы не перемещаются, индекс строится при загрузке */
+    const GridIndex<size_t>& GetOfficeIndex() const noexcept{
+        return office_index_;
+    }
     
     const LootTypes& GetLootTypes() const noexcept;
 
@@ -292,7 +325,11 @@ public:
 
     void AddRoad(const Road& road);
 
-    std::vector<const Road*> FindRoadsByCoords(const Dog::Position& pos) const;
+    /* Буфер для результата поиска дорог, переиспользуемый между вызовами */
+    using RoadsBuffer = std::pmr::vector<const Road*>;
+
+    /* Заменяет содержимое roads дорогами, на которых находится pos */
+    void FindRoadsByCoords(const Dog::Position& pos, RoadsBuffer& roads) const;
 
     void AddBuilding(const Building& building);
 
@@ -308,6 +345,11 @@ public:
 
     unsigned GetBagCapacity() const;
 
+    /* Радиус видимости игрока: состояние игры содержит только объекты в этом радиусе от его собаки */
+    void SetInterestRadius(double radius);
+
+    std::optional<double> GetInterestRadius() const;
+
     static PairDouble GetFirstPos(const model::Map::Roads& roads);
 
     static PairDouble GetRandomPos(const model::Map::Roads& roads);
@@ -319,24 +361,32 @@ private:
     using OfficeIdToIndex = std::unordered_map<Office::Id, size_t, util::TaggedHasher<Office::Id>>;
 
     /* Поиск вертикальных дорог по x координате*/
-    void FindInVerticals(const Dog::Position& pos, std::vector<const Road*>& roads) const;
+    void FindInVerticals(const Dog::Position& pos, RoadsBuffer& roads) const;
 
     /* Поиск горизонтальных дорог по y координате*/
-    void FindInHorizontals(const Dog::Position& pos, std::vector<const Road*>& roads) const;
+    void FindInHorizontals(const Dog::Position& pos, RoadsBuffer& roads) const;
+
+    /* Дороги tag, прямая которых проходит не дальше ширины дороги от coord */
+    void FindInRoads(RoadTag tag, double coord, const Dog::Position& pos, RoadsBuffer& roads) const;
 
     bool CheckBounds(ConstRoadIt it, const Dog::Position& pos) const;
 
     Id id_;
+    Index index_ = 0;
     std::string name_;
     Roads roads_;
     RoadMap road_map_;
     Buildings buildings_;
     LootTypes loot_types_;
 
+    static constexpr double OFFICE_INDEX_CELL_SIZE = 8.;
+
     OfficeIdToIndex warehouse_id_to_index_;
     Offices offices_;
+    GridIndex<size_t> office_index_{OFFICE_INDEX_CELL_SIZE};
     double dog_speed_ = 0;
     unsigned bag_capacity_;
+    std::optional<double> interest_radius_;
 };
 
 class GameSession{
@@ -345,6 +395,10 @@ public:
         : map_(map){
     }
 
+    /* Собаки сессии хранят указатель на нее в обработчиках скорости */
+    GameSession(const GameSession&) = delete;
+    GameSession& operator=(const GameSession&) = delete;
+
     Dog* AddDog(int id, const Dog::Name& name, const Dog::Position& pos, const Dog::Speed& vel, Direction dir);
 
     Dog* AddCreatedDog(Dog new_dog);
@@ -361,30 +415,72 @@ public:
 
     const std::list<Loot>& GetLootObjects() const;
 
-    void DeleteCollectedLoot(const std::set<size_t>& collected_items);
+    /* Удаляет предметы, отмеченные в is_collected по их порядку в GetLootObjects() */
+    void DeleteCollectedLoot(const std::pmr::vector<bool>& is_collected);
 
     void DeleteDog(const Dog* erasing_dog);
+
+    /*
+        Сессия, в которой ни одна собака не движется, не меняется от тиков:
+        неподвижные собаки не перемещаются, не подбирают и не доставляют предметы
+    */
+    bool HasMovingDogs() const{
+        return moving_dogs_ != 0;
+    }
+
+    /* Продлевает время без собак на delta секунд и возвращает его. Если собаки есть, время сбрасывается */
+    double UpdateEmptyTime(double delta){
+        empty_time_ = dogs_.empty() ? empty_time_ + delta : 0.0;
+        return empty_time_;
+    }
 private:
+    /* Подписывает сессию на изменение скорости собаки для учета движущихся собак */
+    Dog* TrackDog(std::list<Dog>::iterator dog);
+
     unsigned auto_loot_counter_ = 0;
+    size_t moving_dogs_ = 0;
+    double empty_time_ = 0.0;
     std::list<Loot> loot_;
     std::list<Dog> dogs_;
+    /* Собаки по id для удаления без поиска по списку */
+    std::unordered_map<int, std::list<Dog>::iterator> dog_by_id_;
     const Map* map_;
 };
 
 class Game {
 public:
     using MapIdHasher = util::TaggedHasher<Map::Id>;
-    using MapIdToIndex = std::unordered_map<Map::Id, size_t, MapIdHasher>;
-    using SessionsByMapId = std::unordered_map<Map::Id, std::deque<GameSession>, MapIdHasher>;
+    using MapIdToIndex = std::unordered_map<Map::Id, Map::Index, MapIdHasher>;
     using Maps = std::deque<Map>;
 
     void AddMap(Map&& map);
 
-    GameSession* AddSession(const Map::Id& map_id);
+    /* Новая сессия занимает слот ранее закрытой сессии карты, если такой есть */
+    GameSession* AddSession(const Map& map);
+
+    GameSession* SessionIsExists(const Map& map);
 
-    GameSession* SessionIsExists(const Map::Id& map_id);
+    template <typename Fn>
+    void ForEachSession(Fn&& fn){
+        for(MapSessions& sessions : sessions_by_map_){
+            for(std::optional<GameSession>& slot : sessions.slots){
+                if(slot){
+                    fn(*slot);
+                }
+            }
+        }
+    }
 
-    const SessionsByMapId& GetAllSessions() const;
+    template <typename Fn>
+    void ForEachSession(Fn&& fn) const{
+        for(const MapSessions& sessions : sessions_by_map_){
+            for(const std::optional<GameSession>& slot : sessions.slots){
+                if(slot){
+                    fn(*slot);
+                }
+            }
+        }
+    }
 
     void SetLootGenerator(double period, double probability);
 
@@ -399,35 +495,103 @@ public:
     void SetDogRetirementTime(unsigned dog_retirement_time);
     
     unsigned GetDogRetirementTime() const;
+
+    /* Сколько секунд сессия может оставаться без игроков, прежде чем будет закрыта */
+    void SetSessionRetirementTime(double session_retirement_time);
+
+    double GetSessionRetirementTime() const;
     
     const Maps& GetMaps() const noexcept;
 
+    /* Поиск по строковому Id: только для данных, пришедших из JSON */
     const Map* FindMap(const Map::Id& id) const noexcept;
 
     detail::Milliseconds GetLootGeneratePeriod() const;
 
     void GenerateLootInSessions(detail::Milliseconds delta);
 
+    /*
+        Продвигает игру на delta миллисекунд.
+        Время шага не ограничено: собаки проходят весь интервал по событиям
+        (край дороги, подбор предмета, доставка в офис) в порядке их наступления
+    */
     void UpdateGameState(unsigned delta);
 
-    void DisconnectDogFromSession(const GameSession* player_session, const Dog* erasing_dog);
+    /* 
+        Собаки, остановившиеся у края дороги за последний вызов UpdateGameState,
+        и сколько секунд они простояли до конца интервала
+    */
+    using StoppedDogs = std::vector<std::pair<const Dog*, double>>;
+
+    const StoppedDogs& GetStoppedDogs() const{
+        return stopped_dogs_;
+    }
+
+    TickArena& GetTickArena(){
+        return tick_arena_;
+    }
+
+    /* 
+        Адреса закрытых сессий. Сессий уже нет, адреса нужны только
+        для удаления связанных с ними данных до создания новых сессий
+    */
+    using RetiredSessions = std::vector<const GameSession*>;
+
+    /*
+        Продлевает на delta миллисекунд время без собак у пустых сессий
+        и закрывает те, что пустуют не меньше GetSessionRetirementTime()
+    */
+    const RetiredSessions& RetireEmptySessions(unsigned delta);
+
+    void DisconnectDogFromSession(GameSession& player_session, const Dog* erasing_dog);
 private:
-    void UpdateAllDogsPositions(std::list<Dog>& dogs, const Map* map, double delta);
+    /* Пути собак сессии за интервал: отрезок i пройден собакой segments[i].dog_index */
+    struct DogPaths{
+        struct Segment{
+            size_t dog_index;
+            double start_time;
+            double duration;
+        };
+
+        explicit DogPaths(std::pmr::memory_resource* memory)
+            : gatherers(memory), segments(memory), roads(memory){}
+
+        std::pmr::vector<collision_detector::Gatherer> gatherers;
+        std::pmr::vector<Segment> segments;
+        /* Буфер поиска дорог при построении путей */
+        Map::RoadsBuffer roads;
+    };
 
-    void UpdateDogPos(Dog& dog, const std::vector<const Road*>& roads, double delta);
+    void SimulateSession(GameSession& session, double delta, std::pmr::memory_resource* memory);
 
-    void UpdateDogsLoot(GameSession& session, double delta);
+    void MoveDog(Dog& dog, size_t dog_index, const Map* map, double delta, DogPaths& paths);
 
-    static bool IsInsideRoad(const PairDouble& getting_pos, const Point& start, const Point& end);
+    /* Сколько собака может пройти в направлении скорости, не покидая дорог roads */
+    static double GetReachableDistance(const PairDouble& pos, const PairDouble& speed, const Map::RoadsBuffer& roads);
+
+    /*
+        Сессии одной карты. Слоты лежат в deque и не перемещаются, поэтому
+        указатели игроков на живые сессии остаются действительными
+    */
+    struct MapSessions{
+        std::deque<std::optional<GameSession>> slots;
+        std::vector<size_t> free_slots;
+    };
 
     Maps maps_;
-    SessionsByMapId map_id_to_sessions_;
+    /* Сессии карты лежат под ее номером Map::GetIndex() */
+    std::deque<MapSessions> sessions_by_map_;
     MapIdToIndex map_id_to_index_;
     std::optional<loot_gen::LootGenerator> loot_generator_;
     double default_dog_speed_ = 1.0;
     double default_bag_capacity_ = 3;
     static constexpr double road_offset_ = 0.4;
     unsigned dog_retirement_time_ = 60;
+    double session_retirement_time_ = 60.0;
+    StoppedDogs stopped_dogs_;
+    RetiredSessions retired_sessions_;
+    /* Временные данные тика: пути собак, события, найденные дороги */
+    TickArena tick_arena_;
 };
 
 }  // namespace model
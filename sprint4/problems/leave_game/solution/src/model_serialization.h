@@ -4,9 +4,55 @@
 #include <boost/serialization/deque.hpp>
 #include <boost/serialization/list.hpp>
 #include <boost/serialization/unordered_map.hpp>
+#include <boost/serialization/vector.hpp>
+#include <boost/serialization/split_free.hpp>
+#include <boost/serialization/level.hpp>
+#include <boost/serialization/tracking.hpp>
+#include <boost/serialization/version.hpp>
 
 
 #include "player.h"
+#include "inline_vector.h"
+
+/*
+    InlineVector записывается как стандартная коллекция, без собственного заголовка класса,
+    поэтому сохраненное в ней содержимое читается так же, как прежний std::deque
+*/
+namespace boost::serialization {
+
+template <typename T, size_t N>
+struct implementation_level<util::InlineVector<T, N>> {
+    using tag = mpl::integral_c_tag;
+    using type = mpl::int_<object_serializable>;
+    BOOST_STATIC_CONSTANT(int, value = type::value);
+};
+
+template <typename T, size_t N>
+struct tracking_level<util::InlineVector<T, N>> {
+    using tag = mpl::integral_c_tag;
+    using type = mpl::int_<track_never>;
+    BOOST_STATIC_CONSTANT(int, value = type::value);
+};
+
+template <typename Archive, typename T, size_t N>
+void save(Archive& ar, const util::InlineVector<T, N>& items, [[maybe_unused]] const unsigned version) {
+    const std::vector<T> collection(items.begin(), items.end());
+    ar << collection;
+}
+
+template <typename Archive, typename T, size_t N>
+void load(Archive& ar, util::InlineVector<T, N>& items, [[maybe_unused]] const unsigned version) {
+    std::vector<T> collection;
+    ar >> collection;
+    items = util::InlineVector<T, N>(collection.begin(), collection.end());
+}
+
+template <typename Archive, typename T, size_t N>
+void serialize(Archive& ar, util::InlineVector<T, N>& items, const unsigned version) {
+    split_free(ar, items, version);
+}
+
+}  // namespace boost::serialization
 
 namespace model {
 
@@ -41,7 +87,7 @@ public:
     :id_(0), name_(), token_(""){}
 
     PlayerRepr(const Player* player)
-    :id_(player->GetId()), name_(*(player->GetName())), token_(*(player->GetToken())){}
+    :id_(player->GetId()), name_(*(player->GetName())), token_(player->GetToken().ToString()){}
 
     int GetId() const{
         return id_;
@@ -79,6 +125,7 @@ public:
         , speed_(*(dog.GetSpeed()))
         , direction_(dog.GetDirection())
         , score_(dog.GetScore())
+        , bag_capacity_(dog.GetBagCapacity())
         , bag_(*(dog.GetBag()))
         , player_repr_(){
     }
@@ -93,17 +140,24 @@ public:
 
     [[nodiscard]] Dog Restore() const {
         Dog dog(id_, Dog::Name(name_), Dog::Position(pos_), Dog::Speed(speed_), direction_);
+        dog.SetScore(score_);
+        dog.SetBagCapacity(bag_capacity_);
+        dog.SetBag(Dog::Bag(bag_));
         return dog;
     }
 
     template <typename Archive>
-    void serialize(Archive& ar, [[maybe_unused]] const unsigned version) {
+    void serialize(Archive& ar, const unsigned version) {
         ar& id_;
         ar& name_;
         ar& pos_;
         ar& speed_;
         ar& direction_;
         ar& score_;
+        /* Сохранения версии 0 не содержат вместимость рюкзака */
+        if(version >= 1){
+            ar& bag_capacity_;
+        }
         ar& bag_;
         ar& player_repr_;
     }
@@ -115,28 +169,34 @@ private:
     PairDouble speed_;
     Direction direction_ = Direction::NORTH;
     unsigned score_ = 0;
-    std::deque<Loot> bag_;
+    unsigned bag_capacity_ = 0;
+    Dog::Bag::ValueType bag_;
     PlayerRepr player_repr_;
 };
 
+/*
+    Представления хранятся в векторах: копия состояния снимается на потоке игры
+    и должна обходиться без выделения памяти на каждый объект.
+    В текстовом архиве вектор записывается так же, как прежний std::list
+*/
 class SessionRepr{
 public:
 
     SessionRepr() = default;
 
     void AddLoots(const std::list<Loot>& loot){
-        loot_ = loot;
+        loot_.assign(loot.begin(), loot.end());
     }
 
-    const std::list<Loot>& GetLoot() const{
+    const std::vector<Loot>& GetLoot() const{
         return loot_;
     }
 
-    void AddDogsRepr(std::list<DogRepr> dogs_repr){
+    void AddDogsRepr(std::vector<DogRepr> dogs_repr){
         dogs_repr_ = std::move(dogs_repr);
     }
 
-    const std::list<DogRepr>& GetDogsRepr() const{
+    const std::vector<DogRepr>& GetDogsRepr() const{
         return dogs_repr_;
     }
 
@@ -146,8 +206,8 @@ public:
         ar& dogs_repr_;
     }
 private:
-    std::list<Loot> loot_;
-    std::list<DogRepr> dogs_repr_;
+    std::vector<Loot> loot_;
+    std::vector<DogRepr> dogs_repr_;
 };
 
 class GameStateRepr{
@@ -155,32 +215,33 @@ public:
     using SessionsByMapId = std::unordered_map<std::string, std::deque<SessionRepr>>;
     GameStateRepr() = default;
 
-    GameStateRepr(const Game::SessionsByMapId& sessions_by_map, const Players& players){
-        for(const auto& [map_id, sessions] : sessions_by_map){
-            std::list<Loot> loot;
-            std::list<DogRepr> dogs_repr;
-            for(const auto& session : sessions){
-                loot = session.GetLootObjects();
-                for(const auto& dog : session.GetDogs()){
-                    dogs_repr.emplace_back(DogRepr(dog));
-
-                    const Player* player = players.FindByDogIdAndMapId(dog.GetId(), *map_id);
-                    PlayerRepr player_repr(player);
-                    dogs_repr.back().AddPlayerRepr(player_repr);
-                }
+    GameStateRepr(const Game& game, const Players& players){
+        game.ForEachSession([this, &players](const GameSession& session){
+            /* Пустая сессия будет закрыта, сохранять ее не нужно */
+            if(session.GetDogs().empty()){
+                return;
+            }
+            std::vector<DogRepr> dogs_repr;
+            dogs_repr.reserve(session.GetDogs().size());
+            for(const auto& dog : session.GetDogs()){
+                dogs_repr.emplace_back(dog).AddPlayerRepr(PlayerRepr(players.FindById(dog.GetId())));
             }
 
             SessionRepr session_repr;
-            session_repr.AddLoots(loot);
-            session_repr.AddDogsRepr(dogs_repr);
+            session_repr.AddLoots(session.GetLootObjects());
+            session_repr.AddDogsRepr(std::move(dogs_repr));
 
-            all_sessions_[*map_id].emplace_back(std::move(session_repr));
-        }
+            all_sessions_[*session.GetMap()->GetId()].emplace_back(std::move(session_repr));
+        });
     }
 
     const SessionsByMapId& GetAllSessions() const{
         return all_sessions_;
     }
+
+    void AddSession(const std::string& map_id, SessionRepr session){
+        all_sessions_[map_id].emplace_back(std::move(session));
+    }
     
     template <typename Archive>
     void serialize(Archive& ar, [[maybe_unused]] const unsigned version) {
@@ -192,3 +253,5 @@ private:
 };
 
 }  // namespace serialization
+
+BOOST_CLASS_VERSION(::serialization::DogRepr, 1)
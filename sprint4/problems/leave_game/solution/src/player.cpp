@@ -1,38 +1,26 @@
-#include <iomanip>
 #include "player.h"
 
-namespace util {
-
-size_t DogMapKeyHasher::operator()(const DogMapKey& value) const{
-    size_t h1 = static_cast<size_t>(value.first);
-    size_t h2 = util::TaggedHasher<model::Map::Id>()(value.second);
-
-    return h1 * 37 + h2 * 37 * 37;
-}
-
-} // namespace util
+#include <algorithm>
+#include <cassert>
 
 namespace model{
 
 /* ------------------------ Players ----------------------------------- */
 
-Player& Players::Add(int id, const Player::Name& name, Dog* dog, const GameSession* session){
-    util::DogMapKey key = std::make_pair(dog->GetId(), session->GetMap()->GetId());
+Player& Players::Add(int id, const Player::Name& name, Dog* dog, GameSession* session){
     Player player(id, name, dog, session);
-    auto [it, is_emplaced] = players_.emplace(key, player);
+    auto [it, is_emplaced] = players_.emplace(id, player);
     if(is_emplaced){
+        next_id_ = std::max(next_id_, id + 1);
         return it->second;
     }
 
     throw std::logic_error("Player has already been added");
 }
 
-const Player* Players::FindByDogIdAndMapId(int dog_id, std::string map_id) const{
-    if(players_.contains(util::DogMapKey(std::make_pair(dog_id, map_id)))){
-        return &players_.at(util::DogMapKey(std::make_pair(dog_id, map_id)));
-    } else {
-        return nullptr;
-    }
+const Player* Players::FindById(int id) const{
+    auto it = players_.find(id);
+    return it != players_.end() ? &it->second : nullptr;
 }
 
 const Players::PlayerList& Players::GetPlayers() const{
@@ -40,41 +28,37 @@ const Players::PlayerList& Players::GetPlayers() const{
 }
 
 void Players::DeletePlayer(const Player* erasing_player){
-    util::DogMapKey key = std::make_pair(erasing_player->GetDog()->GetId(), 
-                                            erasing_player->GetSession()->GetMap()->GetId());
-    auto it = players_.find(key);
-    players_.erase(it);
+    players_.erase(erasing_player->GetId());
 }
 
 /* ---------------------- PlayerTokens ------------------------------------- */
 
 Token PlayerTokens::AddPlayer(Player& player){
-    auto [it, is_emplaced] = token_to_player_.emplace(GenerateToken(), &player);
-    if(is_emplaced){
-        players_by_session_[player.GetSession()].push_back(it->second);
-        player.SetToken(it->first);
-        return it->first;
+    Token token = GenerateToken();
+    if(token_to_player_.Insert(token, &player)){
+        AddPlayerInSession(player, player.GetSession());
+        player.SetToken(token);
+        return token;
     }
 
     throw std::logic_error("Player with this token has already been added");
 }
 
-void PlayerTokens::AddPlayerWithToken(Player& player, Token token){
-    auto [it, is_emplaced] = token_to_player_.emplace(std::move(token), &player);
-    if(!is_emplaced){
+void PlayerTokens::AddPlayerWithToken(Player& player, const Token& token){
+    if(!token_to_player_.Insert(token, &player)){
         throw std::logic_error("Player with this token has already been added");
     }
+    player.SetToken(token);
 }
 
 void PlayerTokens::AddPlayerInSession(Player& player, const GameSession* session){
-    players_by_session_[session].push_back(&player);
+    PlayersInSession& players_in_session = players_by_session_[session];
+    player.SetSessionIndex(players_in_session.size());
+    players_in_session.push_back(&player);
 }
 
 Player* PlayerTokens::FindPlayerByToken(const Token& token){
-    if(token_to_player_.contains(token)){
-        return token_to_player_.at(token);
-    } 
-    return nullptr;
+    return token_to_player_.Find(token);
 }
 
 const PlayerTokens::PlayersInSession& PlayerTokens::GetPlayersBySession(const GameSession* session) const{
@@ -86,10 +70,7 @@ const PlayerTokens::PlayersInSession& PlayerTokens::GetPlayersBySession(const Ga
 }
 
 const Player* PlayerTokens::FindPlayerByToken(const Token& token) const{
-    if(token_to_player_.contains(token)){
-        return const_cast<const Player*>(token_to_player_.at(token));
-    } 
-    return nullptr;
+    return token_to_player_.Find(token);
 }
 
 const PlayerTokens::TokenToPlayer& PlayerTokens::GetAllTokens() const{
@@ -98,28 +79,23 @@ const PlayerTokens::TokenToPlayer& PlayerTokens::GetAllTokens() const{
 
 void PlayerTokens::DeletePlayer(const Player* erasing_player){
     /* Удаляем из хэш-таблицы с токенами */
-    auto token_it = std::find_if(token_to_player_.begin(), 
-                                token_to_player_.end(), 
-                                [erasing_player](const auto& token_and_player){
-                                    return token_and_player.second == erasing_player;});
+    token_to_player_.Erase(erasing_player->GetToken());
 
-    token_to_player_.erase(token_it);
-
-    /* Удаляем из хэш-таблицы c сессиями */
+    /* Удаляем из списка игроков сессии: на место удаляемого встает последний */
     PlayersInSession& players_in_session = players_by_session_.at(erasing_player->GetSession());
-    auto session_it = std::find_if(players_in_session.begin(), 
-                                    players_in_session.end(), 
-                                    [erasing_player](const Player* player){
-                                        return player == erasing_player;});
+    const size_t index = erasing_player->GetSessionIndex();
+    assert(players_in_session[index] == erasing_player);
+    players_in_session[index] = players_in_session.back();
+    players_in_session[index]->SetSessionIndex(index);
+    players_in_session.pop_back();
+}
 
-    players_in_session.erase(session_it);
+void PlayerTokens::DeleteSession(const GameSession* session){
+    players_by_session_.erase(session);
 }
 
 Token PlayerTokens::GenerateToken() {
-    std::ostringstream out;
-    out << std::hex << std::setw(16) << std::setfill('0') << generator1_();
-    out << std::hex << std::setw(16) << std::setfill('0') << generator2_();
-    return Token(out.str());
+    return Token(generator1_(), generator2_());
 }
 
 } // namespace model
\ No newline at end of file
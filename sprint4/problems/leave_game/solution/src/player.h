@@ -1,25 +1,10 @@
 #pragma once
 #include <random>
 #include "model.h"
-
-namespace util {
-
-using DogMapKey = std::pair<int, model::Map::Id>;
-struct DogMapKeyHasher{
-    size_t operator()(const DogMapKey& value) const;
-};
-
-} // namespace util
+#include "token.h"
 
 namespace model{
 
-namespace detail {
-struct TokenTag {};
-}  // namespace detail
-
-using Token = util::Tagged<std::string, detail::TokenTag>;
-
-
 class Players;
 class PlayerTokens;
 
@@ -52,58 +37,88 @@ public:
         return session_;
     }
 
-    void SetToken(Token token){
+    /* Сессия, которой принадлежит собака игрока: через нее собака удаляется при выходе */
+    GameSession* GetSession(){
+        return session_;
+    }
+
+    void SetToken(const Token& token){
         token_ = token;
     }
 
     const Token& GetToken() const {
         return token_;
     }
+
+    /* Позиция в списке игроков сессии, которую ведет PlayerTokens */
+    size_t GetSessionIndex() const{
+        return session_index_;
+    }
+
+    void SetSessionIndex(size_t index){
+        session_index_ = index;
+    }
 private:
     friend PlayerTokens;
     friend Players;
 
-    Player(int id, Name name, Dog* dog, const GameSession* session)
-        : id_(id), name_(name), dog_(dog), token_(""),session_(session){
+    Player(int id, Name name, Dog* dog, GameSession* session)
+        : id_(id), name_(name), dog_(dog), session_(session){
     }
 
     int id_;
     Name name_;
     Token token_;
     Dog* dog_;
-    const GameSession* session_;
+    GameSession* session_;
+    size_t session_index_ = 0;
 };
 
 /* ------------------------ Players ----------------------------------- */
 
+/*
+    Игроки по id. Id игрока совпадает с id его собаки и уникален во всей игре,
+    поэтому добавление, поиск и удаление не зависят от числа игроков и карт
+*/
 class Players{
 public:
-    using PlayerList = std::unordered_map<util::DogMapKey, Player, util::DogMapKeyHasher>;
+    using PlayerList = std::unordered_map<int, Player>;
     Players() = default;
 
-    Player& Add(int id, const Player::Name& name, Dog* dog, const GameSession* session);
+    Player& Add(int id, const Player::Name& name, Dog* dog, GameSession* session);
+
+    const Player* FindById(int id) const;
 
-    const Player* FindByDogIdAndMapId(int dog_id, std::string map_id) const;
+    /* Id, не занятый ни одним игроком, в том числе восстановленным из сохранения */
+    int GetNextId() const{
+        return next_id_;
+    }
 
     const PlayerList& GetPlayers() const;
 
     void DeletePlayer(const Player* erasing_player);
 private:
     PlayerList players_;
+    int next_id_ = 0;
 };
 
 /* ---------------------- PlayerTokens ------------------------------------- */
 
+/*
+    Индексы игроков по токену и по сессии.
+    Список игроков сессии не упорядочен: удаляемый игрок заменяется последним,
+    поэтому вход и выход игрока не зависят от числа игроков в сессии
+*/
 class PlayerTokens{
 public:
-    using PlayersInSession = std::deque<const Player*>;
-    using TokenToPlayer = std::unordered_map<Token, Player*, util::TaggedHasher<Token>>;
+    using PlayersInSession = std::vector<Player*>;
+    using TokenToPlayer = TokenTable<Player*>;
     using SessionToPlayers = std::unordered_map<const model::GameSession*, PlayersInSession>;
     PlayerTokens() = default;
 
     Token AddPlayer(Player& player);
 
-    void AddPlayerWithToken(Player& player, Token token);
+    void AddPlayerWithToken(Player& player, const Token& token);
 
     void AddPlayerInSession(Player& player, const GameSession* session);
 
@@ -116,6 +131,9 @@ public:
     const TokenToPlayer& GetAllTokens() const;
 
     void DeletePlayer(const Player* erasing_player);
+
+    /* Забывает закрытую сессию. Игроков в ней уже нет */
+    void DeleteSession(const GameSession* session);
 private:
     Token GenerateToken();
     std::random_device random_device_;
@@ -129,10 +147,8 @@ private:
         std::uniform_int_distribution<std::mt19937_64::result_type> dist;
         return dist(random_device_);
     }()};
-    // Чтобы сгенерировать токен, получите из generator1_ и generator2_
-    // два 64-разрядных числа и, переведя их в hex-строки, склейте в одну.
-    // Вы можете поэкспериментировать с алгоритмом генерирования токенов,
-    // чтобы сделать их подбор ещё более затруднительным
+    // Токен составляется из двух 64-разрядных чисел generator1_ и generator2_.
+    // В hex-строку он переводится только при передаче клиенту
     TokenToPlayer token_to_player_;
     SessionToPlayers players_by_session_;
 };
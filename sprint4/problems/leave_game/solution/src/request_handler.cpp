@@ -96,23 +96,64 @@ bool IsMatched(const std::string& str, std::string reg_expression){
     return boost::regex_match(str, boost::regex(reg_expression));
 }
 
+admission::Priority GetRequestPriority(std::string_view target){
+    if(target.starts_with("/api/v1/game/join"sv) 
+        || target.starts_with("/api/v1/game/player/action"sv)
+        || target.starts_with("/api/v1/game/tick"sv)){
+        return admission::Priority::HIGH;
+    }
+    return admission::Priority::LOW;
+}
+
+bool IsActionTarget(std::string_view target){
+    return target == "/api/v1/game/player/action"sv;
+}
+
+std::optional<Token> ParseBearerToken(std::string_view authorization){
+    constexpr std::string_view prefix = "Bearer "sv;
+    if(!authorization.starts_with(prefix)){
+        return std::nullopt;
+    }
+    return Token::Parse(authorization.substr(prefix.size()));
+}
+
 } // namespace detail
 
 /* ------------------------ BaseHandler ----------------------------------- */
 
-StringResponse BaseHandler::MakeResponse(http::status status, std::string_view body,
+SharedResponse BaseHandler::MakeResponse(http::status status, std::string_view body,
                                     unsigned http_version, size_t content_length, 
                                     std::string content_type){
-    StringResponse response(status, http_version);
+    SharedResponse response = MakeResponse(status, SharedBuffer(std::string(body)), http_version, std::move(content_type));
+    response.content_length(content_length);
+    return response;
+}
+
+SharedResponse BaseHandler::MakeResponse(http::status status, SharedBuffer body,
+                                    unsigned http_version, std::string content_type){
+    SharedResponse response(status, http_version);
 
     response.set(http::field::content_type, content_type);
     response.set(http::field::cache_control, "no-cache"s);
-    response.body() = body;
-    response.content_length(content_length);
+    response.content_length(body.Size());
+    response.body() = std::move(body);
+    return response;
+}
+
+SharedResponse BaseHandler::MakeResponse(http::status status, const compression::EncodedBody& body,
+                                    unsigned http_version, std::string content_type){
+    SharedBuffer buffer = body.owner ? SharedBuffer(body.owner, body.body) : SharedBuffer(std::string(body.body));
+    SharedResponse response = MakeResponse(status, std::move(buffer), http_version, std::move(content_type));
+    if(body.encoding != compression::Encoding::IDENTITY){
+        response.set(http::field::content_encoding, compression::GetEncodingName(body.encoding));
+    }
+    if(compression::GetSettings().enabled){
+        response.set(http::field::vary, "Accept-Encoding"sv);
+    }
     return response;
 }
 
-StringResponse BaseHandler::MakeErrorResponse(http::status status, std::string_view code, 
+SharedResponse BaseHandler::MakeErrorResponse(http::status status, std::string_view code, 
                                         std::string_view message, unsigned int version){
     using namespace std::literals;
 
@@ -122,6 +163,11 @@ StringResponse BaseHandler::MakeErrorResponse(http::status status, std::string_v
 
 /* -------------------------- FileHandler --------------------------------- */
 
+fs::path FileHandler::GetFilePath(std::string_view req_target) const{
+    fs::path required_path(detail::DecodeTarget(req_target.substr(1)));
+    return fs::weakly_canonical(static_path_ / required_path);
+}
+
 std::string FileHandler::GetRequiredContentType(std::string_view req_target){
     auto point = req_target.find_last_of('.');
     std::string extension;
@@ -3,9 +3,23 @@
 #define BOOST_BEAST_USE_STD_STRING_VIEW
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
+#ifdef BOOST_ASIO_HAS_FILE
+#include <boost/asio/random_access_file.hpp>
+#include <boost/asio/read_at.hpp>
+#endif
+#include <atomic>
+#include <charconv>
+#include <cmath>
 #include <iostream>
 #include "app.h"
 #include "cmd_parser.h"
+#include "admission_control.h"
+#include "request_scheduler.h"
+#include "logger.h"
+#include "metrics.h"
+#include "request_trace.h"
+#include "compression.h"
+#include "shared_body.h"
 #include <iostream>
 #include <filesystem>
 #include <variant>
@@ -49,11 +63,20 @@ std::string MakeErrorCode(std::string_view code, std::string_view message);
 
 bool IsMatched(const std::string& str, std::string reg_expression);
 
+/* Запросы, изменяющие игровое состояние, важнее запросов на чтение и при перегрузке отбрасываются последними */
+admission::Priority GetRequestPriority(std::string_view target);
+
+bool IsActionTarget(std::string_view target);
+
+/* Извлекает токен из заголовка "Authorization: Bearer <token>" */
+std::optional<Token> ParseBearerToken(std::string_view authorization);
+
 }; // namespace detail
 
-using StringResponse = http::response<http::string_body>;
+using http_server::SharedBuffer;
+using http_server::SharedResponse;
 using FileResponse = http::response<http::file_body>;
-using VariantResponse = std::variant<StringResponse, FileResponse>;
+using VariantResponse = std::variant<SharedResponse, FileResponse>;
 
 /* 
     Предварительное объявление 
@@ -70,11 +93,19 @@ class BaseHandler{
 protected:
     explicit BaseHandler() = default;
 
-    StringResponse MakeResponse(http::status status, std::string_view body,
+    SharedResponse MakeResponse(http::status status, std::string_view body,
                                     unsigned http_version, size_t content_length, 
                                     std::string content_type);
 
-    StringResponse MakeErrorResponse(http::status status, std::string_view code, 
+    /* Тело не копируется: ответ разделяет буфер с другими ответами */
+    SharedResponse MakeResponse(http::status status, SharedBuffer body,
+                                    unsigned http_version, std::string content_type);
+
+    /* Ответ с телом, которое может быть сжато: выставляет Content-Encoding и Vary */
+    SharedResponse MakeResponse(http::status status, const compression::EncodedBody& body,
+                                    unsigned http_version, std::string content_type);
+
+    SharedResponse MakeErrorResponse(http::status status, std::string_view code, 
                                     std::string_view message, unsigned int version);
 };
 
@@ -118,7 +149,8 @@ class ApiHandler : public BaseHandler{
 
 public:
     template<typename Request>
-    StringResponse MakeApiResponse(Request&& req){
+    SharedResponse MakeApiResponse(Request&& req){
+        accepted_encoding_ = compression::NegotiateEncoding(req[http::field::accept_encoding]);
         std::string target = std::string(req.target());
         if(detail::IsMatched(target, "(/api/v1/maps)"s)){
             return MakeMapsListsResponse(req);
@@ -129,7 +161,7 @@ public:
                 return MakeAuthResponse(req);
             } else if(detail::IsMatched(target, "(/api/v1/game/players)"s)) {
                 return MakePlayerListResponse(req);
-            } else if(detail::IsMatched(target, "(/api/v1/game/state)"s)) {
+            } else if(detail::IsMatched(target, "(/api/v1/game/state)(\\?.*)?"s)) {
                 return MakeGameStateResponse(req);
             } else if(detail::IsMatched(target, "(/api/v1/game/tick)"s)){
                 return MakeIncreaseTimeResponse(req);
@@ -151,6 +183,47 @@ public:
         app_.LoadState();
     }
 
+    /* Ответ на запрос, отброшенный из-за переполнения очереди api_strand */
+    SharedResponse MakeOverloadResponse(unsigned version){
+        auto res = MakeErrorResponse(http::status::service_unavailable, 
+            "serviceUnavailable"sv, "Server is overloaded, try again later"sv, version);
+        res.set(http::field::retry_after, "1"s);
+        return res;
+    }
+
+    /* 
+        Применяет последнее из объединенных действий игрока.
+        Возвращает false, если игрок с таким токеном не найден
+    */
+    bool ApplyCoalescedAction(const Token& token, const json::object& action){
+        if(!app_.FindPlayerByToken(token)){
+            return false;
+        }
+        app_.ApplyPlayerAction(action, token);
+        return true;
+    }
+
+    /* Контекст трассировки запроса, который обрабатывается в api_strand в данный момент */
+    void SetTrace(tracing::RequestTrace* trace){
+        trace_ = trace;
+    }
+
+    /* Ответ на запрос, обработчик которого завершился непредвиденным исключением */
+    SharedResponse MakeServerErrorResponse(unsigned version){
+        return MakeErrorResponse(http::status::internal_server_error, 
+            "serverError"sv, "Internal server error"sv, version);
+    }
+
+    SharedResponse MakeCoalescedActionResponse(bool is_authorized, unsigned version){
+        if(!is_authorized){
+            return MakeErrorResponse(http::status::unauthorized, 
+                "unknownToken"sv, "Player token has not been found"sv, version);
+        }
+        /* Тело одинаково для всех объединенных действий */
+        static const SharedBuffer empty_object(std::string("{}"s));
+        return BaseHandler::MakeResponse(http::status::ok, empty_object, version, "application/json"s);
+    }
+
 private:
     explicit ApiHandler(model::Game& game, Strand api_strand, 
                         std::optional<unsigned> tick_period, 
@@ -164,6 +237,25 @@ private:
         return app_.GetStrand();
     }
 
+    /* 
+        Тело ответа к этому моменту уже сформировано сценарием приложения,
+        дальше только сжатие и сборка HTTP-ответа.
+        Строка тела переходит в ответ без копирования
+    */
+    SharedResponse MakeResponse(http::status status, std::string body,
+                                    unsigned http_version, std::string content_type){
+        return MakeResponse(status, compression::Encode(std::move(body), accepted_encoding_), 
+            http_version, std::move(content_type));
+    }
+
+    SharedResponse MakeResponse(http::status status, const compression::EncodedBody& body,
+                                    unsigned http_version, std::string content_type){
+        if(trace_){
+            trace_->Mark(tracing::Stamp::HANDLER_DONE);
+        }
+        return BaseHandler::MakeResponse(status, body, http_version, std::move(content_type));
+    }
+
     template<typename Request>
     void DumpRequest(const Request& req){
         std::cout << "HTTP/1.1 "
@@ -188,33 +280,28 @@ private:
             std::cout << "  "sv << header.name_string() << ": "sv << header.value() << std::endl;
         }   
 
-        std::cout << " "sv << res.body() << std::endl;
+        std::cout << " "sv << res.body().View() << std::endl;
     }
 
     template<typename Request>
-    StringResponse MakeMapsListsResponse(Request&& req){
+    SharedResponse MakeMapsListsResponse(Request&& req){
         using namespace std::literals;
 
         SetMethods methods("GET", "HEAD");
         std::string method = std::string(req.method_string());
         if(methods.IsSame(method)){
-            std::string body = app_.GetMapsList();
-            return MakeResponse(http::status::ok, body, 
-                                        req.version(), body.size(), "application/json"s);
+            return MakeResponse(http::status::ok, app_.GetMapsList(accepted_encoding_), 
+                                        req.version(), "application/json"s);
         } else{
             auto res =  MakeErrorResponse(http::status::method_not_allowed, 
                 "invalidMethod"sv, "Only GET method is expected"sv, req.version());
             res.insert("Allow"s, methods.MakeSequence());
             return res;
         }
-
-        std::string body = app_.GetMapsList();
-        return MakeResponse(http::status::ok, body, 
-                                        req.version(), body.size(), "application/json"s);
     }
 
     template<typename Request>
-    StringResponse MakeMapDescResponse(Request&& req){
+    SharedResponse MakeMapDescResponse(Request&& req){
         using namespace std::literals;
 
         SetMethods methods("GET", "HEAD");
@@ -223,9 +310,8 @@ private:
             std::string req_target = std::string(req.target());
             model::Map::Id id(std::string(req_target.substr(13, req_target.npos)));
             if(auto map = app_.FindMap(id); map){
-                std::string body = app_.GetMapDescription(map);
-                return MakeResponse(http::status::ok, body, 
-                                        req.version(), body.size(), "application/json"s);
+                return MakeResponse(http::status::ok, app_.GetMapDescription(map, accepted_encoding_), 
+                                        req.version(), "application/json"s);
             }
 
             return MakeErrorResponse(http::status::not_found, 
@@ -239,7 +325,7 @@ private:
     }
 
     template<typename Request>
-    StringResponse MakeAuthResponse(Request&& req){
+    SharedResponse MakeAuthResponse(Request&& req){
         SetMethods methods("POST");
         std::string method = std::string(req.method_string());
         if(methods.IsSame(method)){
@@ -261,13 +347,14 @@ private:
                             "invalidArgument"sv, "Invalid name"sv, req.version());
                     }
 
-                    if(!app_.FindMap(model::Map::Id(map_id))){
+                    const model::Map* map = app_.FindMap(model::Map::Id(std::move(map_id)));
+                    if(!map){
                         return MakeErrorResponse(http::status::not_found, 
                             "mapNotFound"sv, "Map not found"sv, req.version());
                     }
                     /* Запрос без ошибок */
-                    std::string body = app_.GetJoinGameResult(user_name, map_id);
-                    return MakeResponse(http::status::ok, body, req.version(), body.size(), 
+                    std::string body = app_.GetJoinGameResult(user_name, *map);
+                    return MakeResponse(http::status::ok, std::move(body), req.version(), 
                         "application/json"s);
                 }
                 return MakeErrorResponse(http::status::bad_request, 
@@ -289,21 +376,22 @@ private:
         с переданным ей запросом.
     */
     template <typename Request, typename Fn>
-    StringResponse ExecuteAuthorized(const SetMethods& methods, Request&& req, Fn&& action) {
+    SharedResponse ExecuteAuthorized(const SetMethods& methods, Request&& req, Fn&& action) {
         std::string method = std::string(req.method_string());
         if(methods.IsSame(method)){
             auto it = req.find(http::field::authorization);
             try{
                 if(it != req.end()){
                     std::string_view req_token = it->value();
-                    Token token(std::string(req_token.substr(7, req_token.npos)));
-                    if((*token).size() != 32){
+                    if(req_token.size() < 7 || req_token.size() - 7 != Token::HEX_LENGTH){
                         throw std::logic_error("Incorrect token");
                     }
 
-                    if(app_.FindPlayerByToken(token)){
+                    /* Токен разбирается прямо из заголовка, строка не копируется */
+                    std::optional<Token> token = Token::Parse(req_token.substr(7));
+                    if(token && app_.FindPlayerByToken(*token)){
                         /* Запрос без ошибок */
-                        return action(std::move(req), token);
+                        return action(std::move(req), *token);
                     }
 
                     return MakeErrorResponse(http::status::unauthorized, 
@@ -324,27 +412,57 @@ private:
     }
 
     template<typename Request>
-    StringResponse MakePlayerListResponse(Request&& req){
+    SharedResponse MakePlayerListResponse(Request&& req){
         SetMethods available_methods("GET", "HEAD");
         return ExecuteAuthorized(available_methods, req, [this](Request&& req, const Token& token){
                 std::string body = this->app_.GetPlayerList(token);
-                return this->MakeResponse(http::status::ok, body, req.version(), body.size(), 
+                return this->MakeResponse(http::status::ok, std::move(body), req.version(), 
                     "application/json"s);
         });
     }
 
     template<typename Request>
-    StringResponse MakeGameStateResponse(Request&& req){
+    SharedResponse MakeGameStateResponse(Request&& req){
         SetMethods available_methods("GET", "HEAD");
+        /* Аргументы запроса проверяются после метода и токена, как в остальных сценариях */
         return ExecuteAuthorized(available_methods, req, [this](Request&& req, const Token& token){
-                std::string body = this->app_.GetGameState(token);
-                return this->MakeResponse(http::status::ok, body, req.version(), body.size(), 
-                    "application/json"s);
+                std::optional<double> interest_radius;
+                if(!ParseInterestRadius(req.target(), interest_radius)){
+                    return MakeErrorResponse(http::status::bad_request, 
+                        "invalidArgument"sv, "interestRadius must be a positive number"sv, req.version());
+                }
+                /* Без радиуса снимок состояния и его сжатое представление общие для всех игроков сессии */
+                compression::EncodedBody body = this->app_.GetGameState(token, this->accepted_encoding_, interest_radius);
+                return this->MakeResponse(http::status::ok, body, req.version(), "application/json"s);
         });
     }
 
+    /* 
+        Необязательный радиус видимости: ?interestRadius=<число больше нуля>.
+        Возвращает false, если аргумент задан, но не является конечным положительным числом
+    */
+    static bool ParseInterestRadius(std::string_view target, std::optional<double>& interest_radius){
+        if(target.find('?') == std::string_view::npos){
+            return true;
+        }
+        auto url_args = detail::ParseTargetArgs(target);
+        auto it = url_args.find("interestRadius");
+        if(it == url_args.end()){
+            return true;
+        }
+        /* Строка целиком должна быть конечным числом: inf и nan не принимаются */
+        const std::string& value = it->second;
+        double radius = 0;
+        const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), radius);
+        if(error != std::errc{} || end != value.data() + value.size() || !std::isfinite(radius) || !(radius > 0)){
+            return false;
+        }
+        interest_radius = radius;
+        return true;
+    }
+
     template<typename Request>
-    StringResponse MakeIncreaseTimeResponse(Request&& req){
+    SharedResponse MakeIncreaseTimeResponse(Request&& req){
         if(app_.IsPeriodicMode()){
             return MakeErrorResponse(http::status::bad_request, "badRequest"sv, "Invalid endpoint"sv, req.version());
         }
@@ -359,7 +477,7 @@ private:
 
                         /* Запрос без ошибок */
                         std::string body = app_.IncreaseTime(delta);
-                        return MakeResponse(http::status::ok, body, req.version(), body.size(), 
+                        return MakeResponse(http::status::ok, std::move(body), req.version(), 
                             "application/json"s);
                     } catch(std::exception& ex){
                         return MakeErrorResponse(http::status::bad_request, 
@@ -377,7 +495,7 @@ private:
     }
 
     template<typename Request>
-    StringResponse MakeActionResponse(Request&& req){
+    SharedResponse MakeActionResponse(Request&& req){
         if(auto it = req.find(http::field::content_type); it != req.end()){
             if(it->value() == "application/json"s){
                 try{
@@ -387,7 +505,7 @@ private:
                         SetMethods available_methods("POST");
                         return ExecuteAuthorized(available_methods, req, [this, &action](Request&& req, const Token& token){
                             std::string body = this->app_.ApplyPlayerAction(action, token);
-                            return this->MakeResponse(http::status::ok, body, req.version(), body.size(), 
+                            return this->MakeResponse(http::status::ok, std::move(body), req.version(), 
                             "application/json"s);
                         });
                     } else{
@@ -407,7 +525,7 @@ private:
     }
 
     template<typename Request>
-    StringResponse MakeRecordsResponse(Request&& req){
+    SharedResponse MakeRecordsResponse(Request&& req){
         SetMethods methods("GET", "HEAD");
         std::string method = std::string(req.method_string());
         if(methods.IsSame(method)){
@@ -431,8 +549,8 @@ private:
                 throw std::logic_error("Incorrect maxItems parameter");
             }
             std::string body = app_.GetRecords(start, max_items);
-            return MakeResponse(http::status::ok, body, 
-                                        req.version(), body.size(), "application/json"s);
+            return MakeResponse(http::status::ok, std::move(body), 
+                                        req.version(), "application/json"s);
         }
 
         auto res =  MakeErrorResponse(http::status::method_not_allowed, 
@@ -443,6 +561,9 @@ private:
     }   
 
     Application app_;
+    tracing::RequestTrace* trace_ = nullptr;
+    /* Кодирование, которое принимает клиент текущего запроса */
+    compression::Encoding accepted_encoding_ = compression::Encoding::IDENTITY;
 };
 
 /* -------------------------- FileHandler --------------------------------- */
@@ -458,11 +579,9 @@ public:
         }
 
         http::file_body::value_type file;
-        std::string uncoded_target = detail::DecodeTarget(req.target().substr(1));
         std::string content_type = GetRequiredContentType(req.target());
 
-        fs::path required_path(uncoded_target);
-        fs::path summary_path = fs::weakly_canonical(static_path_ / required_path);
+        fs::path summary_path = GetFilePath(req.target());
         if (sys::error_code ec; file.open(summary_path.string().data(), beast::file_mode::read, ec), ec) {
             std::string empty_body;
             return MakeResponse(http::status::not_found, empty_body,  
@@ -479,6 +598,75 @@ public:
 
         return response;
     }
+
+#ifdef BOOST_ASIO_HAS_FILE
+    /* Файлы больше этого размера отдаются потоково через file_body, а не читаются в память */
+    static constexpr uint64_t MAX_ASYNC_FILE_SIZE = 4 * 1024 * 1024;
+
+    /* false, если io_uring недоступен в ядре и файлы читаются синхронно */
+    bool IsAsyncReadEnabled() const{
+        return async_read_enabled_.load(std::memory_order_relaxed);
+    }
+
+    /* 
+        Читает файл целиком через io_uring и отправляет его содержимое.
+        Большие файлы и ошибки инициализации io_uring обрабатываются синхронным путем
+    */
+    template<typename Request, typename Send>
+    void SendFileResponseAsync(const net::io_context::executor_type& executor, Request&& req, Send&& send, tracing::RequestTrace& trace){
+        if(req.target() == "/"){
+            req.target("/index.html");
+        }
+
+        struct FileRead{
+            net::random_access_file file;
+            std::string body;
+        };
+
+        std::shared_ptr<FileRead> state;
+        sys::error_code ec;
+        uint64_t size = 0;
+        try{
+            state = std::make_shared<FileRead>(FileRead{net::random_access_file(executor), {}});
+            state->file.open(GetFilePath(req.target()).string(), net::file_base::read_only, ec);
+            if(!ec){
+                size = state->file.size(ec);
+            }
+        } catch(const sys::system_error&){
+            /* Ядро не поддерживает io_uring: дальше работаем через обычные системные вызовы */
+            async_read_enabled_.store(false, std::memory_order_relaxed);
+            ec = net::error::operation_not_supported;
+        }
+
+        if(ec || size > MAX_ASYNC_FILE_SIZE){
+            VariantResponse response = MakeFileResponse(std::forward<Request>(req));
+            trace.Mark(tracing::Stamp::HANDLER_DONE);
+            return std::visit([&send](auto&& result) {
+                send(std::forward<decltype(result)>(result));
+            }, std::move(response));
+        }
+
+        state->body.resize(size);
+        net::async_read_at(state->file, 0, net::buffer(state->body), 
+            [state, send = std::forward<Send>(send), trace = &trace, version = req.version(), 
+                content_type = GetRequiredContentType(req.target())](sys::error_code ec, std::size_t bytes_read) mutable {
+                trace->Mark(tracing::Stamp::HANDLER_DONE);
+                SharedResponse response;
+                response.version(version);
+                if(ec){
+                    response.result(http::status::internal_server_error);
+                    response.set(http::field::content_type, "text/plain"sv);
+                } else {
+                    state->body.resize(bytes_read);
+                    response.result(http::status::ok);
+                    response.set(http::field::content_type, content_type);
+                    response.body() = SharedBuffer(std::move(state->body));
+                }
+                response.prepare_payload();
+                send(std::move(response));
+            });
+    }
+#endif
 private:
     explicit FileHandler(fs::path static_path)
         : static_path_(fs::canonical(static_path)){
@@ -486,46 +674,138 @@ private:
 
     std::string GetRequiredContentType(std::string_view req_target);
 
+    /* Путь к файлу в каталоге статических файлов по цели запроса */
+    fs::path GetFilePath(std::string_view req_target) const;
+
     fs::path static_path_;
+#ifdef BOOST_ASIO_HAS_FILE
+    std::atomic<bool> async_read_enabled_{true};
+#endif
+};
+
+/* -------------------------- MetricsHandler --------------------------------- */
+
+/* 
+    Обработчик запросов к служебному порту: отдает метрики в текстовом формате Prometheus
+    и последние медленные запросы с длительностями этапов
+*/
+class MetricsHandler : public BaseHandler{
+public:
+    MetricsHandler() = default;
+
+    template<typename Request, typename Send>
+    void operator()(Request&& req, Send&& send, [[maybe_unused]] tracing::RequestTrace& trace){
+        if(req.method() != http::verb::get && req.method() != http::verb::head){
+            auto res = MakeErrorResponse(http::status::method_not_allowed, 
+                "invalidMethod"sv, "Only GET method is expected"sv, req.version());
+            res.insert("Allow"s, "GET, HEAD"s);
+            return send(std::move(res));
+        }
+        if(req.target() == "/debug/slow-requests"sv){
+            std::string body = tracing::GetTraceRecorder().SerializeSlowRequests();
+            return send(MakeResponse(http::status::ok, SharedBuffer(std::move(body)), req.version(), 
+                "application/json"s));
+        }
+        if(req.target() != "/metrics"sv){
+            return send(MakeErrorResponse(http::status::not_found, 
+                "notFound"sv, "Only /metrics and /debug/slow-requests are served on this port"sv, req.version()));
+        }
+        std::string body = metrics::GetRegistry().Serialize();
+        send(MakeResponse(http::status::ok, SharedBuffer(std::move(body)), req.version(), 
+            "text/plain; version=0.0.4"s));
+    }
 };
 
 /* ------------------------- RequestHandler ---------------------------------- */
 
 class RequestHandler : public std::enable_shared_from_this<RequestHandler>{
 public:
-    explicit RequestHandler(model::Game& game, const cmd_parser::Args& args, Strand api_strand, DatabaseManagerPtr&& db_manager)
+    /*
+        api_strand выполняется в потоке симуляции игры, которому принадлежит модель.
+        io_executor - контекст сетевых потоков для операций, не затрагивающих модель
+    */
+    explicit RequestHandler(model::Game& game, const cmd_parser::Args& args, Strand api_strand, 
+                            net::io_context::executor_type io_executor, DatabaseManagerPtr&& db_manager)
         : game_{game}, 
         api_handler_{game, api_strand, args.tick_period, args.state_file, args.save_state_period, args.randomize_spawn_points, std::move(db_manager)},
-        file_handler_{args.www_root}{}
+        file_handler_{args.www_root},
+        queue_limiter_{args.max_queued_requests},
+        scheduler_{api_strand, std::chrono::microseconds(args.request_slice_budget)},
+        io_executor_{io_executor}{
+            metrics::GetRegistry().AddGaugeCallback("game_server_strand_queue_depth"sv, 
+                "API handlers waiting in api_strand queue"sv, [this]{
+                    return static_cast<int64_t>(queue_limiter_.GetDepth());
+                });
+        }
 
     RequestHandler(const RequestHandler&) = delete;
     RequestHandler& operator=(const RequestHandler&) = delete;
 
     template<typename Request, typename Send>
-    void operator()(Request&& req, Send&& send) {
+    void operator()(Request&& req, Send&& send, tracing::RequestTrace& trace) {
         // Обработать запрос request и отправить ответ, используя send
     
         /* Api запросы обрабатывает ApiHandler*/
         if(detail::IsMatched(std::string(req.target()), "(/api/).*")){
-            auto handle = [self = shared_from_this(), send, req] {
+            /* 
+                Каждый обработчик в api_strand занимает место в очереди.
+                При переполнении очереди запрос сразу получает ответ 503
+            */
+            admission::QueueTicket ticket = queue_limiter_.TryAcquire(detail::GetRequestPriority(req.target()));
+            if(!ticket){
+                metrics::GetServerMetrics().rejected_requests.Add();
+                return send(api_handler_.MakeOverloadResponse(req.version()));
+            }
+
+            if(detail::IsActionTarget(req.target())){
+                if(TrySubmitCoalescedAction(req, send, trace, std::move(ticket))){
+                    return;
+                }
+            }
+
+            trace.Mark(tracing::Stamp::STRAND_ENQUEUE);
+            auto handle = [self = shared_from_this(), send, req, ticket = std::move(ticket), trace = &trace] {
+                trace->Mark(tracing::Stamp::STRAND_START);
+                metrics::GetServerMetrics().GetStrandQueueWait(metrics::TaskClass::REQUEST).Observe(trace->GetStageNs(tracing::Stamp::STRAND_START));
+                SharedResponse response;
                 try {
                     // Этот assert не выстрелит, так как лямбда-функция будет выполняться внутри strand
                     assert(self->api_handler_.GetStrand().running_in_this_thread());
-                    return send(self->api_handler_.MakeApiResponse(req));
+                    self->api_handler_.SetTrace(trace);
+                    response = self->api_handler_.MakeApiResponse(req);
                 } catch (...) {
-                    send(self->api_handler_.MakeErrorResponse(http::status::bad_request, 
-                        "badRequest"sv, "Bad request"sv, req.version()));
+                    response = self->api_handler_.MakeErrorResponse(http::status::bad_request, 
+                        "badRequest"sv, "Bad request"sv, req.version());
+                }
+                self->api_handler_.SetTrace(nullptr);
+                // Ответы с ошибкой собираются без отметки об окончании сценария
+                if(!trace->Has(tracing::Stamp::HANDLER_DONE)){
+                    trace->Mark(tracing::Stamp::HANDLER_DONE);
                 }
+                send(std::move(response));
             };
-            return net::dispatch(api_handler_.GetStrand(), handle);
+            auto on_error = [self = shared_from_this(), send, version = req.version()](std::exception_ptr error){
+                self->api_handler_.SetTrace(nullptr);
+                LogHandlerError(error);
+                send(self->api_handler_.MakeServerErrorResponse(version));
+            };
+            return scheduler_.Submit(scheduling::MakeAnsweringTask(std::move(handle), std::move(on_error)));
         }
 
         /* Запросы доступа к файлам обрабатывает FileHandler*/
+#ifdef BOOST_ASIO_HAS_FILE
+        if(file_handler_.IsAsyncReadEnabled()){
+            return file_handler_.SendFileResponseAsync(io_executor_, 
+                std::forward<decltype(req)>(req), std::forward<Send>(send), trace);
+        }
+#endif
+        VariantResponse file_response = file_handler_.MakeFileResponse(std::forward<decltype(req)>(req));
+        trace.Mark(tracing::Stamp::HANDLER_DONE);
         return std::visit(
-                [&send, &req](auto&& result) {
+                [&send](auto&& result) {
                     send(std::forward<decltype(result)>(result));
                 },
-                file_handler_.MakeFileResponse(std::forward<decltype(req)>(req)));  
+                std::move(file_response));  
     }
 
     void SaveState(){
@@ -537,9 +817,124 @@ public:
     }
 
 private:
+    static void LogHandlerError(std::exception_ptr error){
+        try{
+            std::rethrow_exception(error);
+        } catch(const std::exception& ex){
+            LOG_ERROR(0, ex.what(), "request handler"s);
+        } catch(...){
+            LOG_ERROR(0, "unknown exception"s, "request handler"s);
+        }
+    }
+
+    /* Исключение при применении объединенного действия */
+    enum class ActionError{
+        NONE,
+        /* Некорректное действие: ответ 400, как у MakeActionResponse */
+        INVALID_ARGUMENT,
+        /* Непредвиденная ошибка сервера: ответ 500 */
+        SERVER_ERROR
+    };
+
+    /* Результат объединенного действия, общий для всех ожидающих его запросов */
+    struct CoalescedResult{
+        bool is_authorized = false;
+        ActionError error = ActionError::NONE;
+        uint64_t strand_start_ns = 0;
+        uint64_t handler_done_ns = 0;
+    };
+
+    using ActionCoalescer = admission::ActionCoalescer<Token, json::object, CoalescedResult, TokenHasher>;
+
+    /*
+        Объединяет повторные действия одного игрока.
+        Если у игрока уже есть действие в очереди, новое лишь заменяет его,
+        и ответ будет отправлен после выполнения ожидающего обработчика.
+        Возвращает false, если запрос некорректен и должен пройти обычную обработку,
+        которая сформирует ответ с ошибкой.
+    */
+    template<typename Request, typename Send>
+    bool TrySubmitCoalescedAction(const Request& req, const Send& send, tracing::RequestTrace& trace, admission::QueueTicket&& ticket){
+        if(req.method() != http::verb::post){
+            return false;
+        }
+        auto content_type = req.find(http::field::content_type);
+        auto authorization = req.find(http::field::authorization);
+        if(content_type == req.end() || content_type->value() != "application/json"sv || authorization == req.end()){
+            return false;
+        }
+        std::optional<Token> token = detail::ParseBearerToken(authorization->value());
+        if(!token){
+            return false;
+        }
+
+        json::object action;
+        try{
+            action = json::parse(req.body()).as_object();
+        } catch(...){
+            return false;
+        }
+        if(auto it = action.find("move"); it == action.end() || !it->value().is_string()){
+            return false;
+        }
+
+        unsigned version = req.version();
+        auto waiter = [self = shared_from_this(), send, version, trace = &trace](const CoalescedResult& result){
+            trace->Mark(tracing::Stamp::STRAND_START, result.strand_start_ns);
+            trace->Mark(tracing::Stamp::HANDLER_DONE, result.handler_done_ns);
+            switch(result.error){
+            case ActionError::INVALID_ARGUMENT:
+                return send(self->api_handler_.MakeErrorResponse(http::status::bad_request, 
+                    "invalidArgument"sv, "Failed to parse action"sv, version));
+            case ActionError::SERVER_ERROR:
+                return send(self->api_handler_.MakeServerErrorResponse(version));
+            case ActionError::NONE:
+                break;
+            }
+            send(self->api_handler_.MakeCoalescedActionResponse(result.is_authorized, version));
+        };
+
+        trace.Mark(tracing::Stamp::STRAND_ENQUEUE);
+        if(!action_coalescer_.Submit(*token, std::move(action), std::move(waiter))){
+            /* Действие объединено с уже ожидающим, место в очереди не требуется */
+            return true;
+        }
+
+        auto handle = [self = shared_from_this(), token = std::move(*token), ticket = std::move(ticket), enqueued = tracing::NowNs()] {
+            assert(self->api_handler_.GetStrand().running_in_this_thread());
+            CoalescedResult result;
+            result.strand_start_ns = tracing::NowNs();
+            metrics::GetServerMetrics().GetStrandQueueWait(metrics::TaskClass::REQUEST).Observe(result.strand_start_ns - enqueued);
+            ActionCoalescer::Pending pending = self->action_coalescer_.Take(token);
+            try{
+                result.is_authorized = self->api_handler_.ApplyCoalescedAction(token, pending.action);
+            } catch(const std::invalid_argument&){
+                result.error = ActionError::INVALID_ARGUMENT;
+            } catch(const std::out_of_range&){
+                result.error = ActionError::INVALID_ARGUMENT;
+            } catch(const sys::system_error&){
+                /* Ошибки доступа к полям json::value */
+                result.error = ActionError::INVALID_ARGUMENT;
+            } catch(...){
+                LogHandlerError(std::current_exception());
+                result.error = ActionError::SERVER_ERROR;
+            }
+            result.handler_done_ns = tracing::NowNs();
+            for(const auto& waiter : pending.waiters){
+                waiter(result);
+            }
+        };
+        scheduler_.Submit(scheduling::Task(std::move(handle)));
+        return true;
+    }
+
     model::Game& game_;
     ApiHandler api_handler_;
     FileHandler file_handler_;
+    admission::QueueLimiter queue_limiter_;
+    ActionCoalescer action_coalescer_;
+    scheduling::RequestScheduler scheduler_;
+    net::io_context::executor_type io_executor_;
 };
 
 }  // namespace request_handler
@@ -0,0 +1,69 @@
+#include "request_scheduler.h"
+#include "metrics.h"
+#include "logger.h"
+
+#include <boost/asio/post.hpp>
+#include <cassert>
+
+using namespace std::literals;
+
+namespace scheduling {
+
+void RequestScheduler::Submit(Task task){
+    bool schedule = false;
+    {
+        std::lock_guard lock(mutex_);
+        queue_.push_back(std::move(task));
+        schedule = !std::exchange(pump_scheduled_, true);
+    }
+    if(schedule){
+        SchedulePump();
+    }
+}
+
+void RequestScheduler::SchedulePump(){
+    net::post(strand_, [this]{
+        RunSlice();
+    });
+}
+
+void RequestScheduler::RunSlice(){
+    assert(strand_.running_in_this_thread());
+    const auto deadline = Clock::now() + slice_budget_;
+    do {
+        Task task;
+        {
+            std::lock_guard lock(mutex_);
+            if(queue_.empty()){
+                pump_scheduled_ = false;
+                return;
+            }
+            task = std::move(queue_.front());
+            queue_.pop_front();
+        }
+        /*
+            Исключение обработчика не должно прерывать порцию: иначе pump_scheduled_ останется
+            взведенным и следующие запросы никогда не выполнятся
+        */
+        try{
+            task();
+        } catch(const std::exception& ex){
+            LOG_ERROR(0, ex.what(), "request scheduler"s);
+        } catch(...){
+            LOG_ERROR(0, "unknown exception"s, "request scheduler"s);
+        }
+    } while(Clock::now() < deadline);
+
+    /*
+        Бюджет исчерпан: уступаем strand тактам.
+        Сработавшие таймеры попадают в strand только после опроса реактора io_context,
+        поэтому следующая порция ставится в strand через очередь io_context,
+        т.е. после них, а не сразу за текущей порцией
+    */
+    metrics::GetServerMetrics().request_slices_yielded.Add();
+    net::post(strand_.get_inner_executor(), [this]{
+        SchedulePump();
+    });
+}
+
+} // namespace scheduling
@@ -0,0 +1,113 @@
+#pragma once
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/strand.hpp>
+#include <chrono>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+
+namespace scheduling {
+
+namespace net = boost::asio;
+using Strand = net::strand<net::io_context::executor_type>;
+
+/* ------------------------ Task ----------------------------------- */
+
+/*
+    Обработчик запроса без возможности копирования.
+    std::function не подходит: обработчики владеют QueueTicket
+*/
+class Task{
+public:
+    Task() = default;
+
+    template<typename Fn, typename = std::enable_if_t<!std::is_same_v<std::decay_t<Fn>, Task>>>
+    explicit Task(Fn&& fn)
+        : impl_(std::make_unique<Impl<std::decay_t<Fn>>>(std::forward<Fn>(fn))){}
+
+    void operator()(){
+        impl_->Call();
+    }
+private:
+    struct ImplBase{
+        virtual ~ImplBase() = default;
+        virtual void Call() = 0;
+    };
+
+    template<typename Fn>
+    struct Impl : ImplBase{
+        explicit Impl(Fn fn)
+            : fn(std::move(fn)){}
+
+        void Call() override{
+            fn();
+        }
+
+        Fn fn;
+    };
+
+    std::unique_ptr<ImplBase> impl_;
+};
+
+/*
+    Обработчик запроса, который отвечает при любом исходе.
+    Если handler бросает исключение, вызывается on_error с этим исключением,
+    чтобы отправить клиенту ответ об ошибке: иначе соединение ждало бы ответа, которого не будет
+*/
+template<typename Handler, typename OnError>
+Task MakeAnsweringTask(Handler handler, OnError on_error){
+    return Task([handler = std::move(handler), on_error = std::move(on_error)]() mutable {
+        try{
+            handler();
+        } catch(...){
+            on_error(std::current_exception());
+        }
+    });
+}
+
+/* ------------------------ RequestScheduler ----------------------------------- */
+
+/*
+    Выполняет обработчики запросов в api_strand с более низким приоритетом, чем такты игры.
+    Запросы ждут в собственной очереди, а в strand стоит не больше одной порции.
+    Порция выполняет запросы, пока не истечет slice_budget, и ставит следующую порцию
+    в конец очереди strand. Таймеры тиков и генерации трофеев, сработавшие за это время,
+    выполняются раньше оставшихся запросов.
+    Каждая порция выполняет хотя бы один запрос, поэтому частые или долгие такты
+    не останавливают обработку запросов полностью
+*/
+class RequestScheduler{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    RequestScheduler(Strand strand, Clock::duration slice_budget)
+        : strand_(std::move(strand))
+        , slice_budget_(slice_budget){}
+
+    RequestScheduler(const RequestScheduler&) = delete;
+    RequestScheduler& operator=(const RequestScheduler&) = delete;
+
+    /* Может вызываться из любого потока. Планировщик должен жить, пока очередь strand не опустеет */
+    void Submit(Task task);
+
+    size_t GetQueueSize() const{
+        std::lock_guard lock(mutex_);
+        return queue_.size();
+    }
+private:
+    void RunSlice();
+
+    void SchedulePump();
+
+    Strand strand_;
+    Clock::duration slice_budget_;
+    mutable std::mutex mutex_;
+    std::deque<Task> queue_;
+    /* Порция уже стоит в очереди strand или выполняется */
+    bool pump_scheduled_ = false;
+};
+
+} // namespace scheduling
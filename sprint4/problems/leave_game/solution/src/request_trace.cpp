@@ -0,0 +1,107 @@
+#include "request_trace.h"
+#include "json_writer.h"
+
+namespace tracing {
+
+using namespace std::literals;
+
+/* ------------------------ RequestTrace ----------------------------------- */
+
+uint64_t RequestTrace::GetLatencyNs() const{
+    if(!Has(Stamp::PARSE_DONE) || !Has(Stamp::WRITE_DONE)){
+        return 0;
+    }
+    return Get(Stamp::WRITE_DONE) - Get(Stamp::PARSE_DONE);
+}
+
+uint64_t RequestTrace::GetStageNs(Stamp stamp) const{
+    if(!Has(stamp)){
+        return 0;
+    }
+    for(size_t i = static_cast<size_t>(stamp); i-- > 0;){
+        if(stamps_[i] != 0){
+            /* Отметки с разных потоков: steady_clock монотонен, но защищаемся от перестановки */
+            return stamps_[static_cast<size_t>(stamp)] > stamps_[i] ? stamps_[static_cast<size_t>(stamp)] - stamps_[i] : 0;
+        }
+    }
+    return 0;
+}
+
+std::string_view GetStageName(Stamp stamp){
+    switch(stamp){
+        case Stamp::PARSE_DONE:         return "read"sv;
+        case Stamp::STRAND_ENQUEUE:     return "dispatch"sv;
+        case Stamp::STRAND_START:       return "queue"sv;
+        case Stamp::HANDLER_DONE:       return "handler"sv;
+        case Stamp::SERIALIZATION_DONE: return "serialize"sv;
+        case Stamp::WRITE_DONE:         return "write"sv;
+        default:                        return "unknown"sv;
+    }
+}
+
+/* ------------------------ TraceRecorder ----------------------------------- */
+
+TraceRecorder::TraceRecorder(metrics::Registry& registry){
+    for(size_t route = 0; route < static_cast<size_t>(metrics::Route::COUNT); ++route){
+        /* У отметки READ_START нет предыдущего этапа */
+        for(size_t stamp = static_cast<size_t>(Stamp::PARSE_DONE); stamp < static_cast<size_t>(Stamp::COUNT); ++stamp){
+            std::string labels = "route=\""s;
+            labels.append(metrics::GetRouteName(static_cast<metrics::Route>(route)));
+            labels.append("\",stage=\""sv);
+            labels.append(GetStageName(static_cast<Stamp>(stamp)));
+            labels.push_back('"');
+            stage_duration_[route][stamp] = &registry.AddHistogram("game_server_request_stage_seconds"sv,
+                "Duration of request processing stages"sv, std::move(labels));
+        }
+    }
+}
+
+void TraceRecorder::Record(metrics::Route route, std::string_view target, const RequestTrace& trace){
+    for(size_t stamp = static_cast<size_t>(Stamp::PARSE_DONE); stamp < static_cast<size_t>(Stamp::COUNT); ++stamp){
+        if(trace.Has(static_cast<Stamp>(stamp))){
+            GetStageHistogram(route, static_cast<Stamp>(stamp)).Observe(trace.GetStageNs(static_cast<Stamp>(stamp)));
+        }
+    }
+
+    if(slow_threshold_ns_ == 0 || trace.GetLatencyNs() < slow_threshold_ns_){
+        return;
+    }
+    std::lock_guard lock{slow_mutex_};
+    if(slow_requests_.size() == MAX_SLOW_REQUESTS){
+        slow_requests_.pop_back();
+    }
+    slow_requests_.push_front(SlowRequest{std::chrono::system_clock::now(), route, std::string(target), trace});
+}
+
+std::string TraceRecorder::SerializeSlowRequests() const{
+    std::string result;
+    json_writer::JsonWriter writer(result);
+
+    std::lock_guard lock{slow_mutex_};
+    writer.StartArray();
+    for(const SlowRequest& request : slow_requests_){
+        writer.StartObject();
+        writer.Key("time"sv).Uint(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            request.time.time_since_epoch()).count()));
+        writer.Key("route"sv).String(metrics::GetRouteName(request.route));
+        writer.Key("target"sv).String(request.target);
+        writer.Key("latencyNs"sv).Uint(request.trace.GetLatencyNs());
+        writer.Key("stagesNs"sv).StartObject();
+        for(size_t stamp = static_cast<size_t>(Stamp::PARSE_DONE); stamp < static_cast<size_t>(Stamp::COUNT); ++stamp){
+            if(request.trace.Has(static_cast<Stamp>(stamp))){
+                writer.Key(GetStageName(static_cast<Stamp>(stamp))).Uint(request.trace.GetStageNs(static_cast<Stamp>(stamp)));
+            }
+        }
+        writer.EndObject();
+        writer.EndObject();
+    }
+    writer.EndArray();
+    return result;
+}
+
+TraceRecorder& GetTraceRecorder(){
+    static TraceRecorder recorder(metrics::GetRegistry());
+    return recorder;
+}
+
+} // namespace tracing
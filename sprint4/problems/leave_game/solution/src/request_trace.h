@@ -0,0 +1,122 @@
+#pragma once
+#include "metrics.h"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+namespace tracing {
+
+/*
+    Отметки, которые проставляются по ходу обработки запроса.
+    Порядок перечисления совпадает с порядком прохождения запроса.
+*/
+enum class Stamp{
+    READ_START,         // начато чтение запроса (при keep-alive включает ожидание клиента)
+    PARSE_DONE,         // запрос прочитан и разобран Beast
+    STRAND_ENQUEUE,     // обработчик поставлен в очередь api_strand
+    STRAND_START,       // обработчик начал выполняться в api_strand
+    HANDLER_DONE,       // сценарий приложения выполнен, тело ответа сформировано
+    SERIALIZATION_DONE, // HTTP-ответ собран и передан соединению
+    WRITE_DONE,         // ответ записан в сокет
+    COUNT
+};
+
+/* Время steady_clock в наносекундах */
+inline uint64_t NowNs(){
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        metrics::Clock::now().time_since_epoch()).count());
+}
+
+/* ------------------------ RequestTrace ----------------------------------- */
+
+/*
+    Контекст трассировки одного запроса.
+    Принадлежит соединению и переиспользуется для следующего запроса keep-alive.
+    Нулевая отметка означает, что запрос этот этап не проходил
+    (например, статические файлы не попадают в api_strand).
+*/
+class RequestTrace{
+public:
+    void Reset(){
+        stamps_.fill(0);
+    }
+
+    void Mark(Stamp stamp){
+        stamps_[static_cast<size_t>(stamp)] = NowNs();
+    }
+
+    void Mark(Stamp stamp, uint64_t ns){
+        stamps_[static_cast<size_t>(stamp)] = ns;
+    }
+
+    uint64_t Get(Stamp stamp) const{
+        return stamps_[static_cast<size_t>(stamp)];
+    }
+
+    bool Has(Stamp stamp) const{
+        return Get(stamp) != 0;
+    }
+
+    /* Время от окончания разбора запроса до записи ответа */
+    uint64_t GetLatencyNs() const;
+
+    /* Длительность этапа, который заканчивается отметкой stamp, отсчитанная от ближайшей предыдущей отметки */
+    uint64_t GetStageNs(Stamp stamp) const;
+private:
+    std::array<uint64_t, static_cast<size_t>(Stamp::COUNT)> stamps_{};
+};
+
+/* Имя этапа, который заканчивается отметкой stamp */
+std::string_view GetStageName(Stamp stamp);
+
+/* ------------------------ SlowRequest ----------------------------------- */
+
+/* Медленный запрос, сохраненный целиком для разбора */
+struct SlowRequest{
+    std::chrono::system_clock::time_point time;
+    metrics::Route route;
+    std::string target;
+    RequestTrace trace;
+};
+
+/* ------------------------ TraceRecorder ----------------------------------- */
+
+/*
+    Сводит отметки запросов в гистограммы этапов по маршрутам
+    и хранит последние медленные запросы.
+*/
+class TraceRecorder{
+public:
+    static constexpr size_t MAX_SLOW_REQUESTS = 64;
+
+    explicit TraceRecorder(metrics::Registry& registry);
+
+    /* Запросы медленнее порога сохраняются целиком. 0 - не сохранять */
+    void SetSlowThreshold(std::chrono::milliseconds threshold){
+        slow_threshold_ns_ = static_cast<uint64_t>(std::chrono::nanoseconds(threshold).count());
+    }
+
+    void Record(metrics::Route route, std::string_view target, const RequestTrace& trace);
+
+    /* Сохраненные медленные запросы в формате JSON, от новых к старым */
+    std::string SerializeSlowRequests() const;
+private:
+    metrics::Histogram& GetStageHistogram(metrics::Route route, Stamp stamp){
+        return *stage_duration_[static_cast<size_t>(route)][static_cast<size_t>(stamp)];
+    }
+
+    std::array<std::array<metrics::Histogram*, static_cast<size_t>(Stamp::COUNT)>, static_cast<size_t>(metrics::Route::COUNT)> stage_duration_{};
+    uint64_t slow_threshold_ns_ = 0;
+
+    mutable std::mutex slow_mutex_;
+    std::deque<SlowRequest> slow_requests_;
+};
+
+TraceRecorder& GetTraceRecorder();
+
+} // namespace tracing
@@ -0,0 +1,96 @@
+#pragma once
+// boost.beast будет использовать std::string_view вместо boost::string_view
+#define BOOST_BEAST_USE_STD_STRING_VIEW
+
+#include <boost/asio/buffer.hpp>
+#include <boost/beast/http/message.hpp>
+#include <boost/optional.hpp>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace http_server {
+
+namespace net = boost::asio;
+namespace beast = boost::beast;
+namespace http = beast::http;
+
+/* ------------------------ SharedBuffer ----------------------------------- */
+
+/*
+    Неизменяемые байты со счетчиком ссылок.
+    Один сформированный ответ (описание карты, снимок состояния) разделяется
+    между всеми клиентами, которым он отправляется, без копирования
+*/
+class SharedBuffer {
+public:
+    SharedBuffer() = default;
+
+    /* Забирает строку во владение без копирования байтов */
+    explicit SharedBuffer(std::string data)
+        : SharedBuffer(std::make_shared<const std::string>(std::move(data))) {
+    }
+
+    explicit SharedBuffer(std::shared_ptr<const std::string> data)
+        : view_(data ? std::string_view(*data) : std::string_view{})
+        , owner_(std::move(data)) {
+    }
+
+    /* Часть строки owner, которая живет, пока жив хотя бы один буфер */
+    SharedBuffer(std::shared_ptr<const std::string> owner, std::string_view view)
+        : view_(view)
+        , owner_(std::move(owner)) {
+    }
+
+    std::string_view View() const {
+        return view_;
+    }
+
+    size_t Size() const {
+        return view_.size();
+    }
+private:
+    std::string_view view_;
+    std::shared_ptr<const std::string> owner_;
+};
+
+/* ------------------------ SharedBody ----------------------------------- */
+
+/*
+    Тело ответа Beast поверх SharedBuffer.
+    Сериализатор отдает тело одним буфером без копирования,
+    и заголовок уходит вместе с ним одной операцией записи (writev)
+*/
+struct SharedBody {
+    using value_type = SharedBuffer;
+
+    static std::uint64_t size(const value_type& body) {
+        return body.Size();
+    }
+
+    class writer {
+    public:
+        using const_buffers_type = net::const_buffer;
+
+        template <bool isRequest, typename Fields>
+        writer([[maybe_unused]] const http::header<isRequest, Fields>& header, const value_type& body)
+            : body_(body) {
+        }
+
+        void init(beast::error_code& ec) {
+            ec = {};
+        }
+
+        boost::optional<std::pair<const_buffers_type, bool>> get(beast::error_code& ec) {
+            ec = {};
+            return {{net::const_buffer(body_.View().data(), body_.Size()), false}};
+        }
+    private:
+        const value_type& body_;
+    };
+};
+
+using SharedResponse = http::response<SharedBody>;
+
+}  // namespace http_server
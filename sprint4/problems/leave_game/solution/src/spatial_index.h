@@ -0,0 +1,137 @@
+#pragma once
+#include <cmath>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#include "geom.h"
+
+namespace model {
+
+/* ------------------------ GridIndex ----------------------------------- */
+
+/*
+    Равномерная сетка объектов на карте.
+    Поиск в радиусе просматривает только ячейки, пересекающие квадрат вокруг центра,
+    поэтому его время пропорционально числу найденных объектов, а не всех объектов.
+    Clear сохраняет память ячеек, чтобы индекс перестраивался без выделений.
+    Запрос обрезается по границам занятых ячеек, поэтому бесконечный или огромный
+    прямоугольник не переполняет номера ячеек
+*/
+template<typename Value>
+class GridIndex{
+public:
+    explicit GridIndex(double cell_size = 1.)
+        : cell_size_(cell_size){}
+
+    void Clear(double cell_size){
+        cell_size_ = cell_size;
+        for(auto& [key, cell] : cells_){
+            cell.clear();
+        }
+        size_ = 0;
+        min_cell_ = {std::numeric_limits<double>::max(), std::numeric_limits<double>::max()};
+        max_cell_ = {std::numeric_limits<double>::lowest(), std::numeric_limits<double>::lowest()};
+    }
+
+    void Insert(const PairDouble& pos, Value value){
+        const int64_t x = GetCell(pos.x);
+        const int64_t y = GetCell(pos.y);
+        cells_[MakeKey(x, y)].push_back({pos, std::move(value)});
+        min_cell_ = {std::min(min_cell_.x, static_cast<double>(x)), std::min(min_cell_.y, static_cast<double>(y))};
+        max_cell_ = {std::max(max_cell_.x, static_cast<double>(x)), std::max(max_cell_.y, static_cast<double>(y))};
+        ++size_;
+    }
+
+    size_t Size() const{
+        return size_;
+    }
+
+    /* Вызывает fn для каждого объекта не дальше radius от center */
+    template<typename Fn>
+    void ForEachInRadius(const PairDouble& center, double radius, Fn&& fn) const{
+        const double sq_radius = radius * radius;
+        ForEachCell({center.x - radius, center.y - radius}, {center.x + radius, center.y + radius}, 
+            [&](const Entry& entry){
+                const double dx = entry.pos.x - center.x;
+                const double dy = entry.pos.y - center.y;
+                if(dx * dx + dy * dy <= sq_radius){
+                    fn(entry.value);
+                }
+            });
+    }
+
+    /* Вызывает fn для каждого объекта в прямоугольнике [min, max] */
+    template<typename Fn>
+    void ForEachInRect(const PairDouble& min, const PairDouble& max, Fn&& fn) const{
+        ForEachCell(min, max, [&](const Entry& entry){
+            if(entry.pos.x >= min.x && entry.pos.x <= max.x && entry.pos.y >= min.y && entry.pos.y <= max.y){
+                fn(entry.value);
+            }
+        });
+    }
+private:
+    struct Entry{
+        PairDouble pos;
+        Value value;
+    };
+
+    /* Вызывает fn для каждой записи в ячейках, пересекающих прямоугольник [min, max] */
+    template<typename Fn>
+    void ForEachCell(const PairDouble& min, const PairDouble& max, Fn&& fn) const{
+        /* Границы в номерах ячеек обрезаются до приведения к целому: за занятыми ячейками объектов нет */
+        const double first_x = std::max(std::floor(min.x / cell_size_), min_cell_.x);
+        const double last_x = std::min(std::floor(max.x / cell_size_), max_cell_.x);
+        const double first_y = std::max(std::floor(min.y / cell_size_), min_cell_.y);
+        const double last_y = std::min(std::floor(max.y / cell_size_), max_cell_.y);
+        /* Пустой индекс, прямоугольник вне занятых ячеек или NaN в границах */
+        if(!(first_x <= last_x && first_y <= last_y)){
+            return;
+        }
+        const int64_t min_x = static_cast<int64_t>(first_x);
+        const int64_t max_x = static_cast<int64_t>(last_x);
+        const int64_t min_y = static_cast<int64_t>(first_y);
+        const int64_t max_y = static_cast<int64_t>(last_y);
+
+        auto visit_cell = [&fn](const std::vector<Entry>& cell){
+            for(const Entry& entry : cell){
+                fn(entry);
+            }
+        };
+
+        /* Прямоугольник больше занятой части карты: дешевле просмотреть все ячейки */
+        if(static_cast<double>(max_x - min_x + 1) * static_cast<double>(max_y - min_y + 1) >= static_cast<double>(cells_.size())){
+            for(const auto& [key, cell] : cells_){
+                visit_cell(cell);
+            }
+            return;
+        }
+
+        for(int64_t x = min_x; x <= max_x; ++x){
+            for(int64_t y = min_y; y <= max_y; ++y){
+                if(auto it = cells_.find(MakeKey(x, y)); it != cells_.end()){
+                    visit_cell(it->second);
+                }
+            }
+        }
+    }
+
+    int64_t GetCell(double coord) const{
+        return static_cast<int64_t>(std::floor(coord / cell_size_));
+    }
+
+    static uint64_t MakeKey(int64_t x, int64_t y){
+        return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(y);
+    }
+
+    double cell_size_;
+    size_t size_ = 0;
+    /* Наименьшие и наибольшие номера занятых ячеек по каждой оси */
+    PairDouble min_cell_{std::numeric_limits<double>::max(), std::numeric_limits<double>::max()};
+    PairDouble max_cell_{std::numeric_limits<double>::lowest(), std::numeric_limits<double>::lowest()};
+    std::unordered_map<uint64_t, std::vector<Entry>> cells_;
+};
+
+} // namespace model
@@ -0,0 +1,20 @@
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+
+#include "state_snapshot.h"
+
+/* Переводит сохранение игры из текстового формата Boost.Serialization в бинарный снимок */
+int main(int argc, const char* argv[]) {
+    if (argc != 3) {
+        std::cerr << "Usage: state_converter <text-state-file> <snapshot-file>" << std::endl;
+        return EXIT_FAILURE;
+    }
+    try {
+        serialization::ConvertTextSnapshot(argv[1], argv[2]);
+    } catch (const std::exception& ex) {
+        std::cerr << ex.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
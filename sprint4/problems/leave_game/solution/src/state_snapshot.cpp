@@ -0,0 +1,328 @@
+#include "state_snapshot.h"
+
+#include <array>
+#include <boost/crc.hpp>
+#include <cerrno>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <unistd.h>
+
+namespace serialization {
+
+namespace {
+
+namespace fs = std::filesystem;
+
+constexpr std::array<char, 4> SNAPSHOT_MAGIC{'G', 'S', 'N', 'P'};
+
+/* Начало текстового архива Boost.Serialization: длина и имя сигнатуры */
+constexpr std::string_view TEXT_ARCHIVE_SIGNATURE = "22 serialization::archive";
+
+/* Сигнатура, версия, число секций, CRC-32 первых трех полей, резерв */
+constexpr size_t HEADER_SIZE = 24;
+constexpr size_t HEADER_CRC_OFFSET = 16;
+
+/* Тип, CRC-32 содержимого, длина содержимого */
+constexpr size_t SECTION_HEADER_SIZE = 16;
+
+/* Накопленные секции отправляются в файл, когда буфер вырастает до этого размера */
+constexpr size_t WRITE_BUFFER_SIZE = 1 << 20;
+
+enum class SectionType : uint32_t {
+    SESSION = 1
+};
+
+uint32_t Crc32(std::string_view data) {
+    boost::crc_32_type crc;
+    crc.process_bytes(data.data(), data.size());
+    return crc.checksum();
+}
+
+template <typename T>
+void Put(char* dest, T value) {
+    std::memcpy(dest, &value, sizeof(value));
+}
+
+template <typename T>
+T Get(const char* src) {
+    T value;
+    std::memcpy(&value, src, sizeof(value));
+    return value;
+}
+
+[[noreturn]] void ThrowSystemError(const std::string& what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+/* ------------------------ SnapshotWriter ----------------------------------- */
+
+/*
+    Секции собираются в буфер и записываются во временный файл через pwrite крупными блоками.
+    Место под заголовок резервируется в начале, сам заголовок пишется последним,
+    когда известно число секций. Готовый файл сбрасывается на диск и переименовывается
+    в целевой, поэтому по пути path всегда лежит целый снимок: прежний или новый
+*/
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(const std::string& path)
+        : path_(path)
+        , temp_path_(path + ".tmp")
+        , fd_(open(temp_path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)) {
+        if (fd_ < 0) {
+            ThrowSystemError("Failed to open snapshot file " + temp_path_);
+        }
+        buffer_.reserve(WRITE_BUFFER_SIZE + WRITE_BUFFER_SIZE / 4);
+        buffer_.resize(HEADER_SIZE);
+    }
+
+    SnapshotWriter(const SnapshotWriter&) = delete;
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+    ~SnapshotWriter() {
+        if (fd_ >= 0) {
+            close(fd_);
+            /* Запись не завершена: недописанный файл не нужен */
+            unlink(temp_path_.c_str());
+        }
+    }
+
+    template <typename Fn>
+    void AddSection(SectionType type, Fn&& write_payload) {
+        const size_t start = buffer_.size();
+        buffer_.resize(start + SECTION_HEADER_SIZE);
+        BinaryOutputArchive output_archive{buffer_};
+        write_payload(output_archive);
+
+        const std::string_view payload = std::string_view(buffer_).substr(start + SECTION_HEADER_SIZE);
+        char* header = buffer_.data() + start;
+        Put(header, static_cast<uint32_t>(type));
+        Put(header + 4, Crc32(payload));
+        Put(header + 8, static_cast<uint64_t>(payload.size()));
+        ++sections_;
+
+        if (buffer_.size() >= WRITE_BUFFER_SIZE) {
+            Flush();
+        }
+    }
+
+    void Finish() {
+        Flush();
+
+        std::array<char, HEADER_SIZE> header{};
+        std::memcpy(header.data(), SNAPSHOT_MAGIC.data(), SNAPSHOT_MAGIC.size());
+        Put(header.data() + 4, SNAPSHOT_VERSION);
+        Put(header.data() + 8, sections_);
+        Put(header.data() + HEADER_CRC_OFFSET, Crc32({header.data(), HEADER_CRC_OFFSET}));
+        WriteAt(header.data(), header.size(), 0);
+
+        if (fsync(fd_) < 0) {
+            ThrowSystemError("Failed to flush snapshot");
+        }
+        close(std::exchange(fd_, -1));
+        if (rename(temp_path_.c_str(), path_.c_str()) < 0) {
+            const int error = errno;
+            unlink(temp_path_.c_str());
+            throw std::system_error(error, std::generic_category(), "Failed to replace snapshot " + path_);
+        }
+        SyncDirectory();
+    }
+private:
+    void Flush() {
+        WriteAt(buffer_.data(), buffer_.size(), offset_);
+        offset_ += buffer_.size();
+        buffer_.clear();
+    }
+
+    void WriteAt(const char* data, size_t size, uint64_t offset) {
+        while (size > 0) {
+            const ssize_t written = pwrite(fd_, data, size, static_cast<off_t>(offset));
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                ThrowSystemError("Failed to write snapshot");
+            }
+            data += written;
+            size -= static_cast<size_t>(written);
+            offset += static_cast<uint64_t>(written);
+        }
+    }
+
+    /* Переименование становится постоянным только после сброса каталога */
+    void SyncDirectory() {
+        std::string directory = fs::path(path_).parent_path().string();
+        if (directory.empty()) {
+            directory = ".";
+        }
+        const int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd >= 0) {
+            fsync(fd);
+            close(fd);
+        }
+    }
+
+    std::string path_;
+    std::string temp_path_;
+    int fd_;
+    std::string buffer_;
+    uint64_t offset_ = 0;
+    uint64_t sections_ = 0;
+};
+
+/* ------------------------ MappedFile ----------------------------------- */
+
+/* Файл, отображенный в память только для чтения */
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) {
+        const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            ThrowSystemError("Failed to open snapshot file " + path);
+        }
+        struct stat file_stat{};
+        if (fstat(fd, &file_stat) < 0) {
+            close(fd);
+            ThrowSystemError("Failed to read snapshot file size");
+        }
+        size_ = static_cast<size_t>(file_stat.st_size);
+        if (size_ > 0) {
+            data_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data_ == MAP_FAILED) {
+                data_ = nullptr;
+                close(fd);
+                ThrowSystemError("Failed to map snapshot file");
+            }
+            /* Файл читается один раз от начала до конца */
+            madvise(data_, size_, MADV_SEQUENTIAL);
+        }
+        close(fd);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        if (data_ != nullptr) {
+            munmap(data_, size_);
+        }
+    }
+
+    std::string_view GetData() const {
+        return {static_cast<const char*>(data_), size_};
+    }
+private:
+    void* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+}  // namespace
+
+void WriteSnapshot(const std::string& path, const GameStateRepr& state) {
+    SnapshotWriter writer(path);
+    for (const auto& [map_id, sessions] : state.GetAllSessions()) {
+        for (const SessionRepr& session : sessions) {
+            writer.AddSection(SectionType::SESSION, [&map_id, &session](BinaryOutputArchive& output_archive) {
+                output_archive << map_id << session;
+            });
+        }
+    }
+    writer.Finish();
+}
+
+GameStateRepr ReadSnapshot(const std::string& path) {
+    MappedFile file(path);
+    const std::string_view data = file.GetData();
+
+    if (data.size() < HEADER_SIZE || data.substr(0, SNAPSHOT_MAGIC.size()) != std::string_view(SNAPSHOT_MAGIC.data(), SNAPSHOT_MAGIC.size())) {
+        throw std::runtime_error("File is not a game state snapshot");
+    }
+    if (Get<uint32_t>(data.data() + HEADER_CRC_OFFSET) != Crc32(data.substr(0, HEADER_CRC_OFFSET))) {
+        throw std::runtime_error("Snapshot header is corrupted");
+    }
+    const uint32_t version = Get<uint32_t>(data.data() + 4);
+    if (version == 0 || version > SNAPSHOT_VERSION) {
+        throw std::runtime_error("Unsupported snapshot version " + std::to_string(version));
+    }
+
+    GameStateRepr state;
+    const uint64_t sections = Get<uint64_t>(data.data() + 8);
+    size_t offset = HEADER_SIZE;
+    for (uint64_t i = 0; i < sections; ++i) {
+        if (data.size() - offset < SECTION_HEADER_SIZE) {
+            throw std::runtime_error("Snapshot is truncated");
+        }
+        const char* header = data.data() + offset;
+        const auto type = static_cast<SectionType>(Get<uint32_t>(header));
+        const uint32_t crc = Get<uint32_t>(header + 4);
+        const uint64_t length = Get<uint64_t>(header + 8);
+        offset += SECTION_HEADER_SIZE;
+        if (data.size() - offset < length) {
+            throw std::runtime_error("Snapshot is truncated");
+        }
+        const std::string_view payload = data.substr(offset, length);
+        offset += length;
+        if (Crc32(payload) != crc) {
+            throw std::runtime_error("Snapshot section is corrupted");
+        }
+
+        /* Секции неизвестных типов пропускаются по длине */
+        if (type == SectionType::SESSION) {
+            BinaryInputArchive input_archive{payload, version};
+            std::string map_id;
+            SessionRepr session;
+            input_archive >> map_id >> session;
+            if (!input_archive.AtEnd()) {
+                throw std::runtime_error("Snapshot section has unexpected data");
+            }
+            state.AddSession(map_id, std::move(session));
+        }
+    }
+    if (offset != data.size()) {
+        throw std::runtime_error("Snapshot has unexpected data after the last section");
+    }
+    return state;
+}
+
+bool IsBinarySnapshot(const std::string& path) {
+    std::array<char, SNAPSHOT_MAGIC.size()> magic{};
+    std::ifstream file(path, std::ios::binary);
+    return file.read(magic.data(), magic.size()) && magic == SNAPSHOT_MAGIC;
+}
+
+bool IsTextSnapshot(const std::string& path) {
+    std::array<char, TEXT_ARCHIVE_SIGNATURE.size()> signature{};
+    std::ifstream file(path, std::ios::binary);
+    return file.read(signature.data(), signature.size())
+        && std::string_view(signature.data(), signature.size()) == TEXT_ARCHIVE_SIGNATURE;
+}
+
+GameStateRepr ReadTextSnapshot(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error("Failed to open state file " + path);
+    }
+    boost::archive::text_iarchive input_archive{file};
+    GameStateRepr state;
+    input_archive >> state;
+    return state;
+}
+
+GameStateRepr ReadStateFile(const std::string& path) {
+    if (IsBinarySnapshot(path)) {
+        return ReadSnapshot(path);
+    }
+    if (IsTextSnapshot(path)) {
+        return ReadTextSnapshot(path);
+    }
+    throw std::runtime_error("State file " + path + " is neither a snapshot nor a text archive");
+}
+
+void ConvertTextSnapshot(const std::string& text_path, const std::string& binary_path) {
+    WriteSnapshot(binary_path, ReadTextSnapshot(text_path));
+}
+
+}  // namespace serialization
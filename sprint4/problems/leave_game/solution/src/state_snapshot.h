@@ -0,0 +1,223 @@
+#pragma once
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "model_serialization.h"
+
+namespace serialization {
+
+static_assert(std::endian::native == std::endian::little, "Binary snapshots are written in little-endian byte order");
+
+/*
+    Версия бинарного формата снимка. Увеличивается при изменении представления секций,
+    снимки более новых версий не читаются.
+    Начиная с версии 2 функции serialize получают версию класса из BOOST_CLASS_VERSION,
+    как в текстовом архиве. Снимки версии 1 записаны до появления версий классов:
+    при их чтении все классы имеют версию 0
+*/
+constexpr uint32_t SNAPSHOT_VERSION = 2;
+
+namespace detail {
+
+/* Коллекция, которая записывается как длина и элементы по порядку */
+template <typename T>
+concept Sequence = !std::is_same_v<T, std::string> && requires(T& items, typename T::value_type item) {
+    items.begin();
+    items.end();
+    items.size();
+    items.clear();
+    items.push_back(std::move(item));
+};
+
+/* Вызывает функцию serialize представления так же, как это делает Boost.Serialization */
+template <typename Archive, typename T>
+void SerializeObject(Archive& ar, T& value) {
+    const unsigned version = ar.template GetClassVersion<T>();
+    if constexpr (requires { value.serialize(ar, version); }) {
+        value.serialize(ar, version);
+    } else {
+        serialize(ar, value, version);
+    }
+}
+
+}  // namespace detail
+
+/* ------------------------ BinaryOutputArchive ----------------------------------- */
+
+/*
+    Архив в духе Boost.Serialization, дописывающий байты в строку.
+    Представления состояния записываются своими функциями serialize.
+    Числа и перечисления записываются как есть, строки и коллекции - с длиной uint32
+*/
+class BinaryOutputArchive {
+public:
+    explicit BinaryOutputArchive(std::string& buffer)
+        : buffer_(buffer) {
+    }
+
+    template <typename T>
+    BinaryOutputArchive& operator&(const T& value) {
+        Save(value);
+        return *this;
+    }
+
+    template <typename T>
+    BinaryOutputArchive& operator<<(const T& value) {
+        Save(value);
+        return *this;
+    }
+
+    template <typename T>
+    static unsigned GetClassVersion() {
+        return boost::serialization::version<T>::value;
+    }
+private:
+    void SaveBytes(const void* data, size_t size) {
+        buffer_.append(static_cast<const char*>(data), size);
+    }
+
+    void SaveSize(size_t size) {
+        if (size > std::numeric_limits<uint32_t>::max()) {
+            throw std::length_error("Collection is too large for a snapshot");
+        }
+        const uint32_t value = static_cast<uint32_t>(size);
+        SaveBytes(&value, sizeof(value));
+    }
+
+    template <typename T>
+    void Save(const T& value) {
+        if constexpr (std::is_arithmetic_v<T> || std::is_enum_v<T>) {
+            SaveBytes(&value, sizeof(value));
+        } else if constexpr (std::is_same_v<T, std::string>) {
+            SaveSize(value.size());
+            SaveBytes(value.data(), value.size());
+        } else if constexpr (detail::Sequence<T>) {
+            SaveSize(value.size());
+            for (const auto& item : value) {
+                Save(item);
+            }
+        } else {
+            /* Функции serialize общие для чтения и записи, поэтому принимают неконстантную ссылку */
+            detail::SerializeObject(*this, const_cast<T&>(value));
+        }
+    }
+
+    std::string& buffer_;
+};
+
+/* ------------------------ BinaryInputArchive ----------------------------------- */
+
+/* Читает то, что записал BinaryOutputArchive. При выходе за границы данных бросает исключение */
+class BinaryInputArchive {
+public:
+    BinaryInputArchive(std::string_view data, uint32_t snapshot_version)
+        : data_(data)
+        , snapshot_version_(snapshot_version) {
+    }
+
+    template <typename T>
+    BinaryInputArchive& operator&(T& value) {
+        Load(value);
+        return *this;
+    }
+
+    template <typename T>
+    BinaryInputArchive& operator>>(T& value) {
+        Load(value);
+        return *this;
+    }
+
+    bool AtEnd() const {
+        return offset_ == data_.size();
+    }
+
+    template <typename T>
+    unsigned GetClassVersion() const {
+        return snapshot_version_ >= 2 ? boost::serialization::version<T>::value : 0;
+    }
+private:
+    void LoadBytes(void* dest, size_t size) {
+        if (data_.size() - offset_ < size) {
+            throw std::runtime_error("Snapshot section is truncated");
+        }
+        std::memcpy(dest, data_.data() + offset_, size);
+        offset_ += size;
+    }
+
+    size_t LoadSize() {
+        uint32_t size = 0;
+        LoadBytes(&size, sizeof(size));
+        /* Каждый элемент занимает хотя бы байт: большая длина означает испорченные данные */
+        if (size > data_.size() - offset_) {
+            throw std::runtime_error("Snapshot section is truncated");
+        }
+        return size;
+    }
+
+    template <typename T>
+    void Load(T& value) {
+        if constexpr (std::is_arithmetic_v<T> || std::is_enum_v<T>) {
+            LoadBytes(&value, sizeof(value));
+        } else if constexpr (std::is_same_v<T, std::string>) {
+            const size_t size = LoadSize();
+            value.assign(data_.data() + offset_, size);
+            offset_ += size;
+        } else if constexpr (detail::Sequence<T>) {
+            const size_t size = LoadSize();
+            value.clear();
+            for (size_t i = 0; i < size; ++i) {
+                typename T::value_type item{};
+                Load(item);
+                value.push_back(std::move(item));
+            }
+        } else {
+            detail::SerializeObject(*this, value);
+        }
+    }
+
+    std::string_view data_;
+    uint32_t snapshot_version_;
+    size_t offset_ = 0;
+};
+
+/* ------------------------ Snapshot files ----------------------------------- */
+
+/*
+    Бинарный снимок состояния игры.
+    Файл начинается с заголовка (сигнатура, версия, число секций, CRC-32 заголовка),
+    за которым идут секции: тип, CRC-32 и длина содержимого, затем само содержимое.
+    Каждая секция хранит одну игровую сессию вместе с id ее карты.
+    Файл пишется через буфер вызовами pwrite во временный файл рядом с path,
+    сбрасывается на диск и атомарно заменяет path. Читается через mmap
+*/
+void WriteSnapshot(const std::string& path, const GameStateRepr& state);
+
+/* Бросает исключение, если файл не является снимком или поврежден */
+GameStateRepr ReadSnapshot(const std::string& path);
+
+/* Начинается ли файл с сигнатуры бинарного снимка */
+bool IsBinarySnapshot(const std::string& path);
+
+/* Начинается ли файл с сигнатуры boost::archive::text_oarchive */
+bool IsTextSnapshot(const std::string& path);
+
+/* Состояние, сохраненное прежними версиями сервера через boost::archive::text_oarchive */
+GameStateRepr ReadTextSnapshot(const std::string& path);
+
+/*
+    Читает файл состояния в бинарном или прежнем текстовом формате.
+    Файл другого формата или поврежденный файл приводят к исключению,
+    чтобы сервер не стартовал с пустым миром и не затер сохранение
+*/
+GameStateRepr ReadStateFile(const std::string& path);
+
+void ConvertTextSnapshot(const std::string& text_path, const std::string& binary_path);
+
+}  // namespace serialization
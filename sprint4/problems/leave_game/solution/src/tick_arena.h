@@ -0,0 +1,94 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <utility>
+
+namespace model {
+
+/* ------------------------ TickArena ----------------------------------- */
+
+/*
+    Память для временных данных одного тика симуляции.
+    Выделения берутся из буфера и освобождаются все сразу в начале следующего тика.
+    Если тику не хватило буфера, недостающее выделяется в куче, а к следующему тику
+    буфер увеличивается. В установившемся режиме тик не обращается к куче
+*/
+class TickArena{
+public:
+    explicit TickArena(size_t initial_size = 64 * 1024)
+        : size_(initial_size)
+        , buffer_(std::make_unique<std::byte[]>(size_)){
+        resource_.emplace(buffer_.get(), size_, &upstream_);
+    }
+
+    /* Данные между тиками не хранятся, поэтому перемещенная арена - новый буфер того же размера */
+    TickArena(TickArena&& other)
+        : TickArena(other.size_){}
+
+    TickArena& operator=(const TickArena&) = delete;
+
+    std::pmr::memory_resource* GetResource(){
+        return &*resource_;
+    }
+
+    /* Освобождает память прошлого тика */
+    void Reset(){
+        resource_.reset();
+        if(const size_t overflow = upstream_.TakeBytes(); overflow > 0){
+            size_ = (size_ + overflow) * 2;
+            buffer_ = std::make_unique<std::byte[]>(size_);
+            ++heap_allocations_;
+        }
+        resource_.emplace(buffer_.get(), size_, &upstream_);
+    }
+
+    /* Число выделений в куче с прошлого вызова */
+    uint64_t TakeHeapAllocations(){
+        return std::exchange(heap_allocations_, 0) + upstream_.TakeAllocations();
+    }
+
+    size_t GetCapacity() const{
+        return size_;
+    }
+private:
+    /* Выделяет память в куче и считает выделения */
+    class CountingResource : public std::pmr::memory_resource{
+    public:
+        size_t TakeBytes(){
+            return std::exchange(bytes_, 0);
+        }
+
+        uint64_t TakeAllocations(){
+            return std::exchange(allocations_, 0);
+        }
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override{
+            ++allocations_;
+            bytes_ += bytes;
+            return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+        }
+
+        void do_deallocate(void* p, size_t bytes, size_t alignment) override{
+            std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override{
+            return this == &other;
+        }
+
+        size_t bytes_ = 0;
+        uint64_t allocations_ = 0;
+    };
+
+    size_t size_;
+    std::unique_ptr<std::byte[]> buffer_;
+    CountingResource upstream_;
+    /* Увеличения буфера */
+    uint64_t heap_allocations_ = 0;
+    std::optional<std::pmr::monotonic_buffer_resource> resource_;
+};
+
+} // namespace model
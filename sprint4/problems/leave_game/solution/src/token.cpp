@@ -0,0 +1,60 @@
+#include "token.h"
+
+namespace model {
+
+namespace {
+
+constexpr char HEX_DIGITS[] = "0123456789abcdef";
+
+/* Значение шестнадцатеричной цифры или -1 */
+constexpr int FromHexDigit(char c){
+    if(c >= '0' && c <= '9'){
+        return c - '0';
+    }
+    if(c >= 'a' && c <= 'f'){
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+std::optional<uint64_t> ParseHalf(std::string_view hex){
+    uint64_t result = 0;
+    for(char c : hex){
+        const int digit = FromHexDigit(c);
+        if(digit < 0){
+            return std::nullopt;
+        }
+        result = (result << 4) | static_cast<uint64_t>(digit);
+    }
+    return result;
+}
+
+void WriteHalf(uint64_t value, char* dest){
+    for(int i = 15; i >= 0; --i){
+        dest[i] = HEX_DIGITS[value & 0xF];
+        value >>= 4;
+    }
+}
+
+} // namespace
+
+std::optional<Token> Token::Parse(std::string_view hex){
+    if(hex.size() != HEX_LENGTH){
+        return std::nullopt;
+    }
+    auto high = ParseHalf(hex.substr(0, HEX_LENGTH / 2));
+    auto low = ParseHalf(hex.substr(HEX_LENGTH / 2));
+    if(!high || !low){
+        return std::nullopt;
+    }
+    return Token(*high, *low);
+}
+
+std::string Token::ToString() const{
+    std::string result(HEX_LENGTH, '0');
+    WriteHalf(high_, result.data());
+    WriteHalf(low_, result.data() + HEX_LENGTH / 2);
+    return result;
+}
+
+} // namespace model
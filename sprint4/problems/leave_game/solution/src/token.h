@@ -0,0 +1,156 @@
+#pragma once
+#include <compare>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace model {
+
+/* ------------------------ Token ----------------------------------- */
+
+/*
+    Токен игрока - 128-битное число.
+    Клиенту передается в виде 32 шестнадцатеричных символов в нижнем регистре,
+    при разборе заголовка Authorization строка не копируется.
+*/
+class Token{
+public:
+    static constexpr size_t HEX_LENGTH = 32;
+
+    Token() = default;
+
+    constexpr Token(uint64_t high, uint64_t low)
+        : high_(high), low_(low){}
+
+    /* Возвращает nullopt, если строка не состоит из 32 шестнадцатеричных символов в нижнем регистре */
+    static std::optional<Token> Parse(std::string_view hex);
+
+    std::string ToString() const;
+
+    uint64_t GetHigh() const{
+        return high_;
+    }
+
+    uint64_t GetLow() const{
+        return low_;
+    }
+
+    auto operator<=>(const Token&) const = default;
+private:
+    uint64_t high_ = 0;
+    uint64_t low_ = 0;
+};
+
+struct TokenHasher{
+    size_t operator()(const Token& token) const{
+        /* Токены случайны, достаточно перемешать половины */
+        return static_cast<size_t>(token.GetLow() ^ (token.GetHigh() * 0x9E3779B97F4A7C15ull));
+    }
+};
+
+/* ------------------------ TokenTable ----------------------------------- */
+
+/*
+    Хеш-таблица с открытой адресацией и линейным пробированием: токен -> значение.
+    Элементы лежат в одном массиве, поиск не переходит по указателям между узлами.
+    Пустая ячейка обозначается нулевым значением, поэтому Value - указатель,
+    не равный nullptr для хранимых элементов.
+    Удаление сдвигает следующие элементы цепочки назад, без меток удаления.
+*/
+template <typename Value>
+class TokenTable{
+public:
+    using Slot = std::pair<Token, Value>;
+
+    /* Возвращает false, если токен уже есть в таблице */
+    bool Insert(const Token& token, Value value){
+        if((size_ + 1) * 2 > slots_.size()){
+            Rehash(slots_.empty() ? MIN_CAPACITY : slots_.size() * 2);
+        }
+        size_t index = FindSlot(token);
+        if(slots_[index].second){
+            return false;
+        }
+        slots_[index] = Slot{token, value};
+        ++size_;
+        return true;
+    }
+
+    Value Find(const Token& token) const{
+        if(slots_.empty()){
+            return nullptr;
+        }
+        return slots_[FindSlot(token)].second;
+    }
+
+    bool Contains(const Token& token) const{
+        return Find(token) != nullptr;
+    }
+
+    bool Erase(const Token& token){
+        if(slots_.empty()){
+            return false;
+        }
+        size_t hole = FindSlot(token);
+        if(!slots_[hole].second){
+            return false;
+        }
+        slots_[hole] = Slot{};
+        --size_;
+
+        /* Сдвигаем назад элементы, которые при вставке прошли через освободившуюся ячейку */
+        const size_t mask = slots_.size() - 1;
+        for(size_t index = (hole + 1) & mask; slots_[index].second; index = (index + 1) & mask){
+            const size_t home = TokenHasher{}(slots_[index].first) & mask;
+            if(((index - home) & mask) >= ((index - hole) & mask)){
+                slots_[hole] = std::exchange(slots_[index], Slot{});
+                hole = index;
+            }
+        }
+        return true;
+    }
+
+    size_t Size() const{
+        return size_;
+    }
+
+    /* Обходит все элементы таблицы */
+    template <typename Fn>
+    void ForEach(Fn&& fn) const{
+        for(const Slot& slot : slots_){
+            if(slot.second){
+                fn(slot.first, slot.second);
+            }
+        }
+    }
+private:
+    static constexpr size_t MIN_CAPACITY = 16;
+
+    /* Ячейка с токеном или первая пустая ячейка его цепочки */
+    size_t FindSlot(const Token& token) const{
+        const size_t mask = slots_.size() - 1;
+        size_t index = TokenHasher{}(token) & mask;
+        while(slots_[index].second && slots_[index].first != token){
+            index = (index + 1) & mask;
+        }
+        return index;
+    }
+
+    void Rehash(size_t capacity){
+        std::vector<Slot> old_slots(capacity);
+        old_slots.swap(slots_);
+        for(const Slot& slot : old_slots){
+            if(slot.second){
+                slots_[FindSlot(slot.first)] = slot;
+            }
+        }
+    }
+
+    std::vector<Slot> slots_;
+    size_t size_ = 0;
+};
+
+} // namespace model
@@ -0,0 +1,55 @@
+#include <catch2/catch_test_macros.hpp>
+#include <vector>
+
+#include "../src/inline_vector.h"
+
+using util::InlineVector;
+
+SCENARIO("Inline vector") {
+    GIVEN("a vector with inline capacity 3") {
+        InlineVector<int, 3> items;
+
+        WHEN("it holds no more than 3 items") {
+            items.push_back(1);
+            items.push_back(2);
+            items.emplace_back(3);
+
+            THEN("items are stored inline in insertion order") {
+                CHECK_FALSE(items.spilled());
+                CHECK(std::vector<int>(items.begin(), items.end()) == std::vector<int>{1, 2, 3});
+            }
+        }
+
+        WHEN("it grows beyond the inline capacity") {
+            for(int i = 0; i < 5; ++i){
+                items.push_back(i);
+            }
+
+            THEN("items move to the heap and keep their order") {
+                CHECK(items.spilled());
+                CHECK(items.size() == 5);
+                CHECK(std::vector<int>(items.begin(), items.end()) == std::vector<int>{0, 1, 2, 3, 4});
+            }
+
+            THEN("an item of the vector itself can be appended") {
+                items.push_back(items[0]);
+                CHECK(items[5] == 0);
+            }
+
+            THEN("removing items brings them back inline") {
+                items.pop_back();
+                items.pop_back();
+                CHECK_FALSE(items.spilled());
+                CHECK(items == InlineVector<int, 3>{0, 1, 2});
+            }
+
+            THEN("after clear the vector is empty and inline again") {
+                items.clear();
+                CHECK(items.empty());
+                CHECK_FALSE(items.spilled());
+                items.push_back(7);
+                CHECK(items == InlineVector<int, 3>{7});
+            }
+        }
+    }
+}
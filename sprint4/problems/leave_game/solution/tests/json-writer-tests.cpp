@@ -0,0 +1,133 @@
+#include <catch2/catch_test_macros.hpp>
+#include <boost/json.hpp>
+#include <limits>
+
+#include "../src/json_writer.h"
+
+using namespace json_writer;
+using namespace std::literals;
+namespace json = boost::json;
+
+namespace {
+
+std::string WriteDouble(double value){
+    std::string buffer;
+    JsonWriter writer(buffer);
+    writer.Double(value);
+    return buffer;
+}
+
+}  // namespace
+
+SCENARIO("Doubles are formatted like Boost.JSON") {
+    GIVEN("a set of doubles") {
+        const double values[] = {
+            0.0, -0.0, 1.0, -1.2, 0.5, 3.0, 40.0, 42.2, 0.1, 0.4,
+            1e-7, 1e21, 1e100, 123456.789, 2.5e-3, 1.0 / 3.0,
+            std::numeric_limits<double>::max(),
+            std::numeric_limits<double>::min(),
+            std::numeric_limits<double>::denorm_min()
+        };
+
+        THEN("each one is written byte-for-byte as json::serialize does") {
+            for(double value : values){
+                CHECK(WriteDouble(value) == json::serialize(json::value(value)));
+            }
+        }
+    }
+}
+
+SCENARIO("Strings are escaped like Boost.JSON") {
+    GIVEN("strings with special characters") {
+        const std::string values[] = {
+            ""s, "plain"s, "quote\"s"s, "back\\slash"s, "line\nbreak\ttab\r"s,
+            "\b\f"s, "\x01\x1f"s, "slash/"s, "Юникод"s, std::string("nul\0byte", 8)
+        };
+
+        THEN("each one is written byte-for-byte as json::serialize does") {
+            for(const auto& value : values){
+                std::string buffer;
+                JsonWriter writer(buffer);
+                writer.String(value);
+                CHECK(buffer == json::serialize(json::value(value)));
+            }
+        }
+    }
+}
+
+SCENARIO("Game state document is written like Boost.JSON") {
+    GIVEN("a game state built as DOM tree") {
+        json::object players;
+        json::object player;
+        player["pos"] = {10.0, 2.4};
+        player["speed"] = {0.0, -1.5};
+        player["dir"] = "U";
+        json::array bag;
+        json::object bag_item;
+        bag_item["id"] = 7u;
+        bag_item["type"] = 1u;
+        bag.push_back(bag_item);
+        player["bag"] = bag;
+        player["score"] = 30u;
+        players["0"] = player;
+        players["12"] = json::object{{"pos", {0.0, 0.0}}, {"speed", {0.0, 0.0}}, {"dir", "L"},
+                                     {"bag", json::array{}}, {"score", 0u}};
+
+        json::object lost_objects;
+        lost_objects["7"] = json::object{{"type", 1u}, {"pos", {3.25, 0.0}}};
+
+        json::object state;
+        state["players"] = players;
+        state["lostObjects"] = lost_objects;
+
+        WHEN("the same document is written by JsonWriter") {
+            std::string buffer;
+            JsonWriter writer(buffer);
+            writer.StartObject();
+            writer.Key("players").StartObject();
+                writer.Key(uint64_t{0}).StartObject();
+                    writer.Key("pos").Pair(10.0, 2.4);
+                    writer.Key("speed").Pair(0.0, -1.5);
+                    writer.Key("dir").String("U");
+                    writer.Key("bag").StartArray();
+                        writer.StartObject().Key("id").Uint(7).Key("type").Uint(1).EndObject();
+                    writer.EndArray();
+                    writer.Key("score").Uint(30);
+                writer.EndObject();
+                writer.Key(uint64_t{12}).StartObject();
+                    writer.Key("pos").Pair(0.0, 0.0);
+                    writer.Key("speed").Pair(0.0, 0.0);
+                    writer.Key("dir").String("L");
+                    writer.Key("bag").StartArray().EndArray();
+                    writer.Key("score").Uint(0);
+                writer.EndObject();
+            writer.EndObject();
+            writer.Key("lostObjects").StartObject();
+                writer.Key(uint64_t{7}).StartObject();
+                    writer.Key("type").Uint(1);
+                    writer.Key("pos").Pair(3.25, 0.0);
+                writer.EndObject();
+            writer.EndObject();
+            writer.EndObject();
+
+            THEN("output is identical to json::serialize") {
+                CHECK(buffer == json::serialize(state));
+            }
+        }
+
+        WHEN("the buffer is reused for another document") {
+            std::string buffer;
+            {
+                JsonWriter writer(buffer);
+                writer.StartObject().Key("a").Int(-1).EndObject();
+            }
+            buffer.clear();
+            JsonWriter writer(buffer);
+            writer.StartArray().Int(1).Int(2).EndArray();
+
+            THEN("previous content does not leak into the new one") {
+                CHECK(buffer == json::serialize(json::array{1, 2}));
+            }
+        }
+    }
+}
@@ -0,0 +1,141 @@
+#include <catch2/catch_test_macros.hpp>
+#include <cmath>
+#include <memory_resource>
+
+#include "../src/model.h"
+
+using namespace model;
+using namespace std::literals;
+
+namespace {
+
+bool IsNear(const PairDouble& lhs, const PairDouble& rhs) {
+    return std::abs(lhs.x - rhs.x) < 1e-9 && std::abs(lhs.y - rhs.y) < 1e-9;
+}
+
+std::pmr::vector<const Road*> FindRoads(const Map& map, PairDouble pos) {
+    Map::RoadsBuffer roads;
+    map.FindRoadsByCoords(Dog::Position(pos), roads);
+    return roads;
+}
+
+/* Игра с одной картой из заданных дорог и одной собакой на ней */
+struct Fixture {
+    void AddMap(std::initializer_list<Road> roads) {
+        Map map(Map::Id("map1"s), "Map 1"s);
+        for (const Road& road : roads) {
+            map.AddRoad(road);
+        }
+        map.AddDogSpeed(1);
+        map.AddBagCapacity(3);
+        game.AddMap(std::move(map));
+        session = game.AddSession(*game.FindMap(Map::Id("map1"s)));
+    }
+
+    Dog* AddDog(PairDouble pos, PairDouble speed) {
+        Dog* dog = session->AddDog(0, Dog::Name("dog"s), Dog::Position(pos), Dog::Speed({0, 0}), Direction::NORTH);
+        dog->SetSpeed(Dog::Speed(speed));
+        return dog;
+    }
+
+    Game game;
+    GameSession* session = nullptr;
+};
+
+}  // namespace
+
+SCENARIO("Road lookup by coordinates") {
+    GIVEN("a map with a horizontal, a vertical and a reversed horizontal road") {
+        Map map(Map::Id("map1"s), "Map 1"s);
+        map.AddRoad(Road(Road::HORIZONTAL, {0, 0}, 10));
+        map.AddRoad(Road(Road::VERTICAL, {5, -5}, 5));
+        map.AddRoad(Road(Road::HORIZONTAL, {20, 10}, 10));
+
+        THEN("a point on a horizontal road finds only that road") {
+            const auto roads = FindRoads(map, {2, 0.3});
+            REQUIRE(roads.size() == 1);
+            CHECK(roads.front()->IsHorizontal());
+        }
+
+        THEN("a point on a vertical road finds only that road") {
+            const auto roads = FindRoads(map, {5.3, 3});
+            REQUIRE(roads.size() == 1);
+            CHECK(roads.front()->IsVertical());
+        }
+
+        THEN("a point at the intersection finds both roads") {
+            CHECK(FindRoads(map, {5, 0}).size() == 2);
+        }
+
+        THEN("road edges include half of the road width") {
+            CHECK(FindRoads(map, {5.4, -5.4}).size() == 1);
+            CHECK(FindRoads(map, {10.4, 0.4}).size() == 1);
+            CHECK(FindRoads(map, {5.5, 3}).empty());
+            CHECK(FindRoads(map, {2, -0.5}).empty());
+        }
+
+        THEN("a road given from end to start is found as well") {
+            const auto roads = FindRoads(map, {15, 9.8});
+            REQUIRE(roads.size() == 1);
+            CHECK(roads.front()->IsInvert());
+        }
+    }
+}
+
+SCENARIO_METHOD(Fixture, "Dog movement along roads") {
+    GIVEN("two horizontal roads meeting end to end") {
+        AddMap({Road(Road::HORIZONTAL, {0, 0}, 10), Road(Road::HORIZONTAL, {10, 0}, 20)});
+        Dog* dog = AddDog({8, 0}, {2, 0});
+
+        WHEN("the dog runs across the junction") {
+            game.UpdateGameState(2000);
+
+            THEN("it continues on the next road without stopping") {
+                CHECK(IsNear(*dog->GetPosition(), {12, 0}));
+                CHECK(*dog->GetSpeed() == PairDouble{2, 0});
+                CHECK(game.GetStoppedDogs().empty());
+            }
+        }
+    }
+
+    GIVEN("a horizontal and a vertical road crossing") {
+        AddMap({Road(Road::HORIZONTAL, {0, 0}, 10), Road(Road::VERTICAL, {5, -5}, 5)});
+
+        WHEN("a dog turns from the intersection onto the vertical road") {
+            Dog* dog = AddDog({5, 0}, {0, 1});
+            game.UpdateGameState(3000);
+
+            THEN("it moves along the vertical road") {
+                CHECK(IsNear(*dog->GetPosition(), {5, 3}));
+                CHECK(game.GetStoppedDogs().empty());
+            }
+        }
+
+        WHEN("a dog on the horizontal road away from the intersection runs sideways") {
+            Dog* dog = AddDog({2, 0}, {0, -1});
+            game.UpdateGameState(1000);
+
+            THEN("it stops at the side of the road") {
+                CHECK(IsNear(*dog->GetPosition(), {2, -0.4}));
+                CHECK(*dog->GetSpeed() == PairDouble{0, 0});
+            }
+        }
+    }
+
+    GIVEN("a single road") {
+        AddMap({Road(Road::HORIZONTAL, {0, 0}, 10)});
+        Dog* dog = AddDog({8, 0}, {2, 0});
+
+        WHEN("the dog reaches the end of the road inside the interval") {
+            game.UpdateGameState(2000);
+
+            THEN("it stops at the road edge and stands for the rest of the interval") {
+                CHECK(IsNear(*dog->GetPosition(), {10.4, 0}));
+                CHECK(*dog->GetSpeed() == PairDouble{0, 0});
+                REQUIRE(game.GetStoppedDogs().size() == 1);
+                CHECK(game.GetStoppedDogs().front().first == dog);
+                CHECK(std::abs(game.GetStoppedDogs().front().second - 0.8) < 1e-9);
+            }
+        }
+    }
+}
@@ -0,0 +1,96 @@
+#include <catch2/catch_test_macros.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "../src/request_scheduler.h"
+
+using namespace scheduling;
+using namespace std::literals;
+
+namespace {
+
+/* Отметка такта игры в порядке выполнения */
+constexpr int TICK = -1;
+
+}  // namespace
+
+SCENARIO("Request scheduler") {
+    GIVEN("a scheduler on a strand") {
+        net::io_context ioc;
+        RequestScheduler scheduler(net::make_strand(ioc), 1ms);
+        std::vector<int> completed;
+
+        WHEN("tasks are submitted") {
+            for(int i = 0; i < 3; ++i){
+                scheduler.Submit(Task([&completed, i]{ completed.push_back(i); }));
+            }
+            ioc.run();
+
+            THEN("they run in submission order") {
+                CHECK(completed == std::vector<int>{0, 1, 2});
+                CHECK(scheduler.GetQueueSize() == 0);
+            }
+        }
+
+        WHEN("a task throws") {
+            scheduler.Submit(Task([&completed]{ completed.push_back(0); }));
+            scheduler.Submit(Task([]{ throw std::runtime_error("handler failed"); }));
+            scheduler.Submit(Task([&completed]{ completed.push_back(2); }));
+            ioc.run();
+
+            THEN("the tasks queued after it still run") {
+                CHECK(completed == std::vector<int>{0, 2});
+            }
+
+            THEN("later submissions are processed") {
+                ioc.restart();
+                scheduler.Submit(Task([&completed]{ completed.push_back(3); }));
+                ioc.run();
+                CHECK(completed == std::vector<int>{0, 2, 3});
+            }
+        }
+
+        WHEN("a handler made by MakeAnsweringTask throws") {
+            int status = 0;
+            scheduler.Submit(MakeAnsweringTask([]{
+                    throw std::runtime_error("handler failed");
+                }, [&status](std::exception_ptr){
+                    status = 500;
+                }));
+            ioc.run();
+
+            THEN("the request still gets an error answer") {
+                CHECK(status == 500);
+            }
+        }
+    }
+
+    GIVEN("requests that exhaust the slice budget") {
+        net::io_context ioc;
+        auto strand = net::make_strand(ioc);
+        RequestScheduler scheduler(strand, 1ms);
+        std::vector<int> completed;
+
+        WHEN("a tick is posted to the strand in the middle of a slice") {
+            scheduler.Submit(Task([&]{
+                net::post(strand, [&completed]{ completed.push_back(TICK); });
+                std::this_thread::sleep_for(2ms);
+                completed.push_back(0);
+            }));
+            for(int i = 1; i < 4; ++i){
+                scheduler.Submit(Task([&completed, i]{
+                    std::this_thread::sleep_for(2ms);
+                    completed.push_back(i);
+                }));
+            }
+            ioc.run();
+
+            THEN("the queued requests yield to the tick") {
+                CHECK(completed == std::vector<int>{0, TICK, 1, 2, 3});
+            }
+        }
+    }
+}
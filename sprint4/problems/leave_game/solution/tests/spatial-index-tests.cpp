@@ -0,0 +1,83 @@
+#include <catch2/catch_test_macros.hpp>
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "../src/spatial_index.h"
+
+using namespace model;
+
+namespace {
+
+std::vector<int> FindInRadius(const GridIndex<int>& index, PairDouble center, double radius){
+    std::vector<int> result;
+    index.ForEachInRadius(center, radius, [&result](int value){
+        result.push_back(value);
+    });
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+} // namespace
+
+SCENARIO("Grid index search in radius") {
+    GIVEN("an index filled with random points") {
+        std::mt19937_64 generator{42};
+        std::uniform_real_distribution<double> coord(-100., 100.);
+        GridIndex<int> index(8.);
+        std::vector<PairDouble> points;
+        for(int i = 0; i < 1000; ++i){
+            points.push_back({coord(generator), coord(generator)});
+            index.Insert(points.back(), i);
+        }
+
+        auto brute_force = [&points](PairDouble center, double radius){
+            std::vector<int> result;
+            for(int i = 0; i < static_cast<int>(points.size()); ++i){
+                const double dx = points[i].x - center.x;
+                const double dy = points[i].y - center.y;
+                if(dx * dx + dy * dy <= radius * radius){
+                    result.push_back(i);
+                }
+            }
+            return result;
+        };
+
+        THEN("it finds the same points as a full scan") {
+            CHECK(index.Size() == points.size());
+            for(double radius : {0.5, 3., 8., 20., 50.}){
+                for(int i = 0; i < 20; ++i){
+                    PairDouble center{coord(generator), coord(generator)};
+                    CHECK(FindInRadius(index, center, radius) == brute_force(center, radius));
+                }
+            }
+        }
+
+        THEN("a radius larger than the map finds every point") {
+            CHECK(FindInRadius(index, {0, 0}, 1e9).size() == points.size());
+        }
+
+        THEN("an infinite or huge radius finds every point without overflowing cell numbers") {
+            const double inf = std::numeric_limits<double>::infinity();
+            CHECK(FindInRadius(index, {0, 0}, inf).size() == points.size());
+            CHECK(FindInRadius(index, {0, 0}, 1e300).size() == points.size());
+            CHECK(FindInRadius(index, {1e300, -1e300}, 1e10).empty());
+        }
+
+        THEN("a NaN radius finds nothing") {
+            CHECK(FindInRadius(index, {0, 0}, std::numeric_limits<double>::quiet_NaN()).empty());
+        }
+
+        WHEN("the index is cleared") {
+            index.Clear(4.);
+            index.Insert({1, 1}, 7);
+
+            THEN("only new points are found") {
+                CHECK(index.Size() == 1);
+                CHECK(FindInRadius(index, {0, 0}, 1e9) == std::vector<int>{7});
+                CHECK(FindInRadius(index, {0, 0}, 1.).empty());
+            }
+        }
+    }
+}
@@ -58,17 +58,21 @@ SCENARIO_METHOD(Fixture, "Dog Serialization") {
             }
 
             THEN("it can be deserialized") {
-                // InputArchive input_archive{strm};
-                // serialization::DogRepr repr;
-                // input_archive >> repr;
-                // const auto restored = repr.Restore();
+                InputArchive input_archive{strm};
+                serialization::DogRepr repr;
+                input_archive >> repr;
+                const auto restored = repr.Restore();
 
-                // CHECK(dog.GetId() == restored.GetId());
-                // CHECK(dog.GetName() == restored.GetName());
-                // CHECK(dog.GetPosition() == restored.GetPosition());
-                // CHECK(dog.GetSpeed() == restored.GetSpeed());
-                // CHECK(dog.GetBagCapacity() == restored.GetBagCapacity());
-                // CHECK(dog.GetBag() == restored.GetBag());
+                CHECK(dog.GetId() == restored.GetId());
+                CHECK(dog.GetName() == restored.GetName());
+                CHECK(dog.GetPosition() == restored.GetPosition());
+                CHECK(dog.GetSpeed() == restored.GetSpeed());
+                CHECK(dog.GetScore() == restored.GetScore());
+                CHECK(dog.GetBagCapacity() == restored.GetBagCapacity());
+                CHECK(dog.GetBag() == restored.GetBag());
+                REQUIRE((*restored.GetBag()).size() == 1);
+                CHECK((*restored.GetBag())[0].id == 10);
+                CHECK((*restored.GetBag())[0].type == 2);
             }
         }
     }
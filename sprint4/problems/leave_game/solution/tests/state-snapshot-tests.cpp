@@ -0,0 +1,127 @@
+#include <catch2/catch_test_macros.hpp>
+#include <filesystem>
+#include <fstream>
+
+#include "../src/state_snapshot.h"
+
+using namespace model;
+using namespace std::literals;
+namespace fs = std::filesystem;
+
+namespace {
+
+struct Fixture {
+    Fixture() {
+        Map map(Map::Id("map1"s), "Map 1"s);
+        map.AddRoad(Road(Road::HORIZONTAL, {0, 0}, 10));
+        game.AddMap(std::move(map));
+
+        GameSession* session = game.AddSession(*game.FindMap(Map::Id("map1"s)));
+        session->SetLootObjects({Loot{1, 0, 10, {1.5, 0}}, Loot{2, 1, 20, {7, 0}}});
+        for (int id = 0; id < 2; ++id) {
+            Dog* dog = session->AddDog(id, Dog::Name("dog"s + std::to_string(id)), Dog::Position({2.5 * id, 0}),
+                                       Dog::Speed({1, 0}), Direction::EAST);
+            dog->SetScore(5 * id);
+            dog->SetBagCapacity(3);
+            dog->CollectItem(Loot{10u + id, 0, 10, {0, 0}});
+            Player& player = players.Add(id, Player::Name("player"s + std::to_string(id)), dog, session);
+            player.SetToken(Token(0x1234 + id, 0xabcd));
+        }
+    }
+
+    ~Fixture() {
+        fs::remove(path);
+    }
+
+    Game game;
+    Players players;
+    std::string path = (fs::temp_directory_path() / "game-state-snapshot-test").string();
+};
+
+}  // namespace
+
+SCENARIO_METHOD(Fixture, "Binary state snapshot") {
+    GIVEN("a saved game state") {
+        const serialization::GameStateRepr state(game, players);
+        serialization::WriteSnapshot(path, state);
+
+        THEN("it is recognized as a binary snapshot") {
+            CHECK(serialization::IsBinarySnapshot(path));
+        }
+
+        THEN("it is read back unchanged") {
+            const auto restored = serialization::ReadSnapshot(path);
+            REQUIRE(restored.GetAllSessions().size() == 1);
+            const auto& sessions = restored.GetAllSessions().at("map1"s);
+            REQUIRE(sessions.size() == 1);
+            CHECK(sessions.front().GetLoot().size() == 2);
+            CHECK(sessions.front().GetLoot().back().value == 20);
+
+            REQUIRE(sessions.front().GetDogsRepr().size() == 2);
+            const auto& dog_repr = sessions.front().GetDogsRepr().back();
+            const Dog dog = dog_repr.Restore();
+            CHECK(dog.GetId() == 1);
+            CHECK(*dog.GetName() == "dog1"s);
+            CHECK(*dog.GetPosition() == PairDouble{2.5, 0});
+            CHECK(dog.GetDirection() == Direction::EAST);
+            CHECK(dog.GetScore() == 5);
+            CHECK(dog.GetBagCapacity() == 3);
+            REQUIRE((*dog.GetBag()).size() == 1);
+            CHECK((*dog.GetBag())[0].id == 11);
+            CHECK(dog_repr.GetPlayerRepr().GetName() == "player1"s);
+            CHECK(dog_repr.GetPlayerRepr().GetToken() == Token(0x1235, 0xabcd).ToString());
+        }
+
+        WHEN("a byte of the file is damaged") {
+            {
+                std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+                file.seekp(static_cast<std::streamoff>(fs::file_size(path) - 3));
+                file.put('\x7f');
+            }
+
+            THEN("reading fails") {
+                CHECK_THROWS(serialization::ReadSnapshot(path));
+            }
+        }
+
+        WHEN("a byte of the signature is damaged") {
+            {
+                std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+                file.seekp(1);
+                file.put('X');
+            }
+
+            THEN("the file is not taken for a text archive and loading fails") {
+                CHECK_FALSE(serialization::IsBinarySnapshot(path));
+                CHECK_FALSE(serialization::IsTextSnapshot(path));
+                CHECK_THROWS(serialization::ReadStateFile(path));
+            }
+        }
+    }
+
+    GIVEN("a game state saved in the text format") {
+        {
+            std::ofstream file(path);
+            boost::archive::text_oarchive output_archive{file};
+            output_archive << serialization::GameStateRepr(game, players);
+        }
+        REQUIRE_FALSE(serialization::IsBinarySnapshot(path));
+        REQUIRE(serialization::IsTextSnapshot(path));
+
+        THEN("it is loaded as a state file") {
+            CHECK(serialization::ReadStateFile(path).GetAllSessions().at("map1"s).size() == 1);
+        }
+
+        WHEN("it is converted") {
+            const std::string binary_path = path + ".bin"s;
+            serialization::ConvertTextSnapshot(path, binary_path);
+            const auto restored = serialization::ReadSnapshot(binary_path);
+            fs::remove(binary_path);
+
+            THEN("the snapshot holds the same sessions") {
+                REQUIRE(restored.GetAllSessions().count("map1"s) == 1);
+                CHECK(restored.GetAllSessions().at("map1"s).front().GetDogsRepr().size() == 2);
+            }
+        }
+    }
+}
@@ -0,0 +1,145 @@
+#include <catch2/catch_test_macros.hpp>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include "../src/model.h"
+#include "../src/tick_arena.h"
+
+using namespace model;
+using namespace std::literals;
+
+/* ------------------------ Heap allocation hook ----------------------------------- */
+
+/* Обращения к глобальному operator new в тестовом бинарнике: считаются только внутри ScopedAllocationCounter */
+namespace {
+
+std::atomic<bool> counting_allocations{false};
+std::atomic<uint64_t> counted_allocations{0};
+
+class ScopedAllocationCounter {
+public:
+    ScopedAllocationCounter() {
+        counted_allocations = 0;
+        counting_allocations = true;
+    }
+
+    ~ScopedAllocationCounter() {
+        counting_allocations = false;
+    }
+
+    uint64_t GetAllocations() const {
+        return counted_allocations;
+    }
+};
+
+}  // namespace
+
+void* operator new(std::size_t size) {
+    if (counting_allocations.load(std::memory_order_relaxed)) {
+        counted_allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (void* p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+SCENARIO("Tick arena") {
+    GIVEN("an arena with a small buffer") {
+        TickArena arena(256);
+
+        WHEN("a tick needs more memory than the buffer holds") {
+            {
+                std::pmr::vector<int> data(arena.GetResource());
+                data.resize(1000);
+            }
+
+            THEN("the overflow is taken from the heap and counted") {
+                CHECK(arena.TakeHeapAllocations() > 0);
+            }
+
+            AND_WHEN("the next ticks need the same amount") {
+                arena.Reset();
+                arena.TakeHeapAllocations();
+                const size_t capacity = arena.GetCapacity();
+                CHECK(capacity > 256);
+
+                uint64_t allocations = 0;
+                {
+                    ScopedAllocationCounter counter;
+                    for (int tick = 0; tick < 10; ++tick) {
+                        arena.Reset();
+                        std::pmr::vector<int> tick_data(arena.GetResource());
+                        tick_data.resize(1000);
+                    }
+                    allocations = counter.GetAllocations();
+                }
+
+                THEN("the grown buffer serves them without heap allocations") {
+                    CHECK(allocations == 0);
+                    CHECK(arena.TakeHeapAllocations() == 0);
+                    CHECK(arena.GetCapacity() == capacity);
+                }
+            }
+        }
+    }
+}
+
+SCENARIO("Game ticks in steady state") {
+    GIVEN("a session with dogs running on crossing roads") {
+        Game game;
+        Map map(Map::Id("map1"s), "Map 1"s);
+        map.AddRoad(Road(Road::HORIZONTAL, {0, 0}, 40));
+        map.AddRoad(Road(Road::VERTICAL, {20, 0}, 40));
+        map.AddDogSpeed(1);
+        map.AddBagCapacity(3);
+        game.AddMap(std::move(map));
+        GameSession* session = game.AddSession(*game.FindMap(Map::Id("map1"s)));
+
+        std::vector<Dog*> dogs;
+        for (int id = 0; id < 20; ++id) {
+            const bool horizontal = id % 2 == 0;
+            dogs.push_back(session->AddDog(id, Dog::Name("dog"s + std::to_string(id)),
+                                           Dog::Position(horizontal ? PairDouble{id + 1., 0} : PairDouble{20, id + 1.}),
+                                           Dog::Speed({0, 0}), Direction::NORTH));
+        }
+
+        /* Собаки бегают туда и обратно, каждый второй тик часть из них упирается в край дороги */
+        auto run_ticks = [&](int count) {
+            for (int tick = 0; tick < count; ++tick) {
+                const double speed = tick % 2 == 0 ? 1 : -1;
+                for (size_t i = 0; i < dogs.size(); ++i) {
+                    dogs[i]->SetSpeed(Dog::Speed(i % 2 == 0 ? PairDouble{speed, 0} : PairDouble{0, speed}));
+                }
+                game.UpdateGameState(1500);
+            }
+        };
+
+        WHEN("the arena has grown to the tick's needs") {
+            run_ticks(10);
+            game.GetTickArena().TakeHeapAllocations();
+
+            uint64_t allocations = 0;
+            {
+                ScopedAllocationCounter counter;
+                run_ticks(100);
+                allocations = counter.GetAllocations();
+            }
+
+            THEN("ticks do not allocate on the heap") {
+                CHECK(allocations == 0);
+                CHECK(game.GetTickArena().TakeHeapAllocations() == 0);
+            }
+        }
+    }
+}
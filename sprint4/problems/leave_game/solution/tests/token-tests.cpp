@@ -0,0 +1,86 @@
+#include <catch2/catch_test_macros.hpp>
+#include <random>
+#include <unordered_map>
+
+#include "../src/token.h"
+
+using namespace model;
+using namespace std::literals;
+
+SCENARIO("Token hex representation") {
+    GIVEN("a token") {
+        const Token token(0x0123456789abcdefull, 0x00000000000000ffull);
+
+        THEN("it is written as 32 lower case hex digits") {
+            CHECK(token.ToString() == "0123456789abcdef00000000000000ff"s);
+        }
+
+        THEN("the written string is parsed back to the same token") {
+            auto parsed = Token::Parse(token.ToString());
+            REQUIRE(parsed.has_value());
+            CHECK(*parsed == token);
+        }
+    }
+
+    WHEN("a string is not a token") {
+        THEN("it is not parsed") {
+            CHECK_FALSE(Token::Parse(""sv).has_value());
+            CHECK_FALSE(Token::Parse("0123456789abcdef"sv).has_value());
+            CHECK_FALSE(Token::Parse("0123456789abcdef00000000000000ff0"sv).has_value());
+            CHECK_FALSE(Token::Parse("0123456789ABCDEF00000000000000ff"sv).has_value());
+            CHECK_FALSE(Token::Parse("0123456789abcdeg00000000000000ff"sv).has_value());
+        }
+    }
+}
+
+SCENARIO("Token table") {
+    GIVEN("a table filled with random tokens") {
+        std::mt19937_64 generator{42};
+        TokenTable<const int*> table;
+        std::unordered_map<Token, const int*, TokenHasher> expected;
+        std::vector<int> values(1000);
+
+        for(size_t i = 0; i < values.size(); ++i){
+            Token token(generator(), generator() & 0xFF);
+            CHECK(table.Insert(token, &values[i]));
+            expected.emplace(token, &values[i]);
+        }
+
+        THEN("every token is found") {
+            CHECK(table.Size() == expected.size());
+            for(const auto& [token, value] : expected){
+                CHECK(table.Find(token) == value);
+            }
+        }
+
+        THEN("a token can not be inserted twice") {
+            CHECK_FALSE(table.Insert(expected.begin()->first, &values[0]));
+            CHECK(table.Size() == expected.size());
+        }
+
+        WHEN("half of the tokens are erased") {
+            size_t index = 0;
+            for(auto it = expected.begin(); it != expected.end();){
+                if(index++ % 2 == 0){
+                    CHECK(table.Erase(it->first));
+                    CHECK_FALSE(table.Contains(it->first));
+                    it = expected.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+
+            THEN("the remaining tokens are still found") {
+                CHECK(table.Size() == expected.size());
+                for(const auto& [token, value] : expected){
+                    CHECK(table.Find(token) == value);
+                }
+                size_t visited = 0;
+                table.ForEach([&visited](const Token&, const int*){
+                    ++visited;
+                });
+                CHECK(visited == expected.size());
+            }
+        }
+    }
+}